@@ -1,14 +1,19 @@
-function build_readPLXFileC(debug)
+function build_readPLXFileC(debug, openmp)
 % BUILD_READPLXFILEC - Wrapper for building the readPLXFileC MEX function.
 % 
 % This function can be used to compile readPLXFileC. It embeds into the
 % resulting MEX file the date/time the source code was last modified, which
 % is useful for comparing and debugging different revisions of the code.
 %
-% The only input (debug) is true/false and dicates whether the debugging
+% The first input (debug) is true/false and dicates whether the debugging
 % flags are enabled in the resulting MEX file ('true' adds the '-g' flag
 % when calling 'mex'). Default is false.
 %
+% The second input (openmp) is true/false and dictates whether OpenMP is
+% enabled, to decode the continuous channels on multiple threads ('dense'
+% and 'scaled' options). If the compilation with OpenMP fails, the function
+% is compiled without it. Default is true.
+%
 % Author: Benjamin Kraus (bkraus@bu.edu, ben@benkraus.com)
 % Last Modified: $Date: 2013-06-09 19:58:09 -0400 (Sun, 09 Jun 2013) $
 % Copyright (c) 2012-2013, Benjamin Kraus
@@ -16,6 +21,7 @@ function build_readPLXFileC(debug)
 
 % By default build a 'release' package, instead of a 'debugging' package.
 if(nargin < 1); debug = false; end
+if(nargin < 2); openmp = true; end
 
 % File name of the source code.
 f = 'readPLXFileC';
@@ -50,13 +56,29 @@ assert(~isempty(finfo),[mfilename ':SourceNotFound'],...
 d = sprintf('-DLASTMODDATE=%s',datestr(finfo.date,'yyyy-mm-dd'));
 t = sprintf('-DLASTMODTIME=%s',datestr(finfo.date,'HH:MM:SS'));
 
+% OpenMP flags for the compiler and linker.
+o = {};
+if(openmp)
+    if(ispc)
+        o = {'COMPFLAGS=$COMPFLAGS /openmp'};
+    elseif(~ismac)
+        o = {'CFLAGS=$CFLAGS -fopenmp','LDFLAGS=$LDFLAGS -fopenmp'};
+    end
+end
+
 % Compile the function
 if(debug)
     % Compile with debugging symbols.
-    mex('-g',d,t,'-outdir',p,f);
+    g = {'-g'};
 else
     % Compile for release (without debugging symbols).
-    mex(d,t,'-outdir',p,f);
-end    
+    g = {};
+end
+try
+    mex(g{:},o{:},d,t,'-outdir',p,f);
+catch err
+    if(isempty(o)); rethrow(err); end
+    mex(g{:},d,t,'-outdir',p,f);
+end
 
 end
@@ -38,11 +38,37 @@
 #include <mex.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#define PLX_FSEEK _fseeki64
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define PLX_FSEEK fseeko
+#endif
 
 #include "PlexonFiles.h"
 
 #define MAX_NUM_UNITS (26)
 #define MAX_DBH_WORDS (512)
+#define PLX_INDEX_GROUP (256)
+#define PLX_INDEX_MAGIC ("PLXIDX1")
+#define PLX_INDEX_EXT (".idx")
+#define PLX_DENSE_CHUNK (1024)
+#define MAX_NUM_STREAMS (64)
+#define PLX_STREAM_SLACK (1)
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 #define MAKETS(up,low) ((((UINT64_T)(up))<<32) + (UINT64_T)(low))
@@ -161,6 +187,8 @@ int disphelp()
    plx = readPLXFileC(filename, varargin)\n\
    plx = readPLXFileC('help')\n\
    plx = readPLXFileC('version')\n\
+   plx = readPLXFileC('read', handle, duration)\n\
+   readPLXFileC('close', handle)\n\
  \n\
  INPUT:\n\
    filename - Name of the PLX file to read.\n\
@@ -182,6 +210,13 @@ int disphelp()
                       (implies 'nospikes','noevents','nocontinuous')\n\
    '[no]fullread'   - Scan the entire file (default = 'nofullread')\n\
                       ('fullread' is implied if anything other than headers are requested)\n\
+   '[no]index'      - Read the data blocks through a block index (default = 'index')\n\
+                      The index is built with a single scan of the file, and kept in\n\
+                      memory for the next calls on the same file. Time ranges are then\n\
+                      read without scanning the blocks before the start time.\n\
+                      'noindex' scans the whole file sequentially at each call.\n\
+   'indexfile'      - Same as 'index', and load/save the index from/to a file\n\
+                      next to the PLX file (filename + '.idx')\n\
    '[no]spikes'     - Retrieve (or not) spike timestamps (default = 'nospikes')\n\
                       'nospikes' implies 'nowaves'\n\
    '[no]waves'      - Retrieve (or not) spike waveforms (default = 'nowaves')\n\
@@ -190,6 +225,28 @@ int disphelp()
                       0 = unsorted, 1 = unit 'a', 2 = unit 'b', etc.\n\
    '[no]events'     - Retrieve (or not) event data (default = 'noevents')\n\
    '[no]continuous' - Retrieve (or not) continuous data (default = 'no')\n\
+   'dense'          - Return the continuous channels as a single [nChannels x nTime]\n\
+                      int16 matrix (field 'ContinuousData') instead of fragments.\n\
+                      Column k is the sample at time start+k/Fs. Gaps are filled with zeros.\n\
+                      Can be followed by a list of channels (rows of the matrix).\n\
+                      All the channels must have the same sampling frequency.\n\
+   'scaled'         - Same as 'dense', with values converted to Volts (single),\n\
+                      using the gains of the continuous channel headers.\n\
+   'open'           - Open a stream: return the headers, and a handle (field 'Handle').\n\
+                      The data is then read by chunks of 'duration' seconds with\n\
+                      readPLXFileC('read', handle, duration), from 'start' (or the\n\
+                      beginning of the file), with the data types and channels selected\n\
+                      when opening. Each chunk contains the data in [StreamStart, StreamStop),\n\
+                      and the dense matrices of consecutive chunks can be concatenated.\n\
+                      For the continuous fragments, the field 'Continued' indicates if\n\
+                      the first fragment continues the last fragment of the previous chunk.\n\
+                      Only the blocks of the current chunk are indexed, so the memory used\n\
+                      does not depend on the length of the file. 'StreamEnd' is true in the\n\
+                      chunk that contains the last data of the selected types. The file is\n\
+                      only open during the calls to 'read', and must not be modified while\n\
+                      the stream is open.\n\
+                      readPLXFileC('close', handle) closes the stream,\n\
+                      readPLXFileC('close') closes all the streams.\n\
    'all'            - Read the entire file\n\
                       (implies 'spikes','waves','events','continuous')\n\
    'range'          - Time range of data to retrieve\n\
@@ -200,7 +257,7 @@ int disphelp()
    'last'           - Last data sample to retrieve\n\
  \n\
  SELECTING CHANNELS:\n\
-   'spikes','waves','events', and/or 'continuous' can be followed by a\n\
+   'spikes','waves','events','continuous' and/or 'dense' can be followed by a\n\
    numerical array, which is then parsed to determine which channels to\n\
    retrieve. An empty array implies 'no'. If the array is missing,\n\
    then all channels are retrieved.\n\
@@ -245,7 +302,504 @@ bool verifyPLXStruct(const mxArray *plx)
             );
 }
 
-int tallyrange(mxArray *datacounts[5], FILE* fp,
+/* BLOCK INDEX
+ *
+ * The index lists the file offset and the header of every data block,
+ * so that the data section is scanned only once per file. The running
+ * maximum of the block end times and the running minimum (from the end)
+ * of the block start times are kept for each group of PLX_INDEX_GROUP
+ * blocks: both are monotonic, so the range of blocks that overlap a time
+ * window is found with two binary searches, even if the blocks are not
+ * perfectly sorted in time.
+ *
+ * The index of the last file read is kept in memory between calls, and
+ * it can be saved next to the PLX file (filename + PLX_INDEX_EXT). It is
+ * only reused if the size, modification time and data start location
+ * of the file did not change.
+ *
+ * When the index is used, the file is memory mapped (if possible), and
+ * the blocks are read directly from the mapped memory.
+ */
+typedef struct
+{
+    UINT64_T offset;                /* Offset of the data block header in the file */
+    struct PL_DataBlockHeader dbh;  /* Copy of the data block header */
+} PLXIndexEntry;
+
+typedef struct
+{
+    char *fname;        /* Name of the indexed file */
+    UINT64_T filesize;  /* Size of the indexed file (bytes) */
+    UINT64_T filetime;  /* Modification time of the indexed file */
+    UINT64_T datastart; /* Offset of the first data block */
+    UINT64_T n;         /* Number of data blocks */
+    UINT64_T ngroups;   /* Number of groups of blocks */
+    PLXIndexEntry *blocks;
+    UINT64_T *maxend;   /* Running maximum of block end times, for each group */
+    UINT64_T *minstart; /* Running minimum of block start times from the end, for each group */
+} PLXIndex;
+
+typedef struct
+{
+    FILE *fp;
+    const char *fname;
+    bool useindex;      /* Read the blocks through the index */
+    bool indexfile;     /* Load/save the index from/to a sidecar file */
+    int typemask;       /* Block types to return: bit (1 << Type) */
+    UINT64_T filesize;
+    UINT64_T filetime;
+    const char *map;    /* Memory mapped file (NULL if not mapped) */
+#ifdef _WIN32
+    HANDLE hfile, hmap;
+#else
+    int fd;
+#endif
+    PLXIndex *idx;
+    UINT64_T next;      /* Next index entry to read */
+    UINT64_T last;      /* End of the range of index entries to read */
+    UINT64_T offset;    /* Offset of the current data block header */
+} PLXReader;
+
+static PLXIndex *cachedindex = NULL;
+
+void freePLXIndex(PLXIndex *idx)
+{
+    if(idx == NULL) return;
+    if(idx->fname    != NULL) mxFree(idx->fname);
+    if(idx->blocks   != NULL) mxFree(idx->blocks);
+    if(idx->maxend   != NULL) mxFree(idx->maxend);
+    if(idx->minstart != NULL) mxFree(idx->minstart);
+    mxFree(idx);
+}
+
+void clearPLXIndexCache(void)
+{
+    freePLXIndex(cachedindex);
+    cachedindex = NULL;
+}
+
+/* Get the size and modification time of the file, and map it into memory.
+ * The size and time are read from the open stream fp: if they are not available,
+ * the index is not used (it would be saved in the cache with a wrong file size). */
+void openPLXReader(PLXReader *rd, FILE *fp, const char *fname)
+{
+    rd->fp = fp;
+    rd->fname = fname;
+    rd->typemask = (1 << PL_SingleWFType) | (1 << PL_ExtEventType) | (1 << PL_ADDataType);
+    rd->filesize = 0;
+    rd->filetime = 0;
+    rd->map = NULL;
+    rd->idx = NULL;
+    rd->next = 0;
+    rd->last = 0;
+    rd->offset = 0;
+    if(!rd->useindex) return;
+#ifdef _WIN32
+    {
+        struct __stat64 st;
+        rd->hfile = INVALID_HANDLE_VALUE;
+        rd->hmap = NULL;
+        if(_fstat64(_fileno(fp), &st) != 0 || st.st_size <= 0)
+        {
+            rd->useindex = false;
+            return;
+        }
+        rd->filesize = (UINT64_T)st.st_size;
+        rd->filetime = (UINT64_T)st.st_mtime;
+        rd->hfile = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(rd->hfile == INVALID_HANDLE_VALUE) return;
+        if((UINT64_T)(SIZE_T)rd->filesize != rd->filesize) return;
+        rd->hmap = CreateFileMappingA(rd->hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(rd->hmap == NULL) return;
+        rd->map = (const char *)MapViewOfFile(rd->hmap, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    {
+        struct stat st;
+        void *ptr;
+        rd->fd = -1;
+        if(fstat(fileno(fp), &st) != 0 || st.st_size <= 0)
+        {
+            rd->useindex = false;
+            return;
+        }
+        rd->filesize = (UINT64_T)st.st_size;
+        rd->filetime = (UINT64_T)st.st_mtime;
+        if((UINT64_T)(size_t)rd->filesize != rd->filesize) return;
+        rd->fd = open(fname, O_RDONLY);
+        if(rd->fd < 0) return;
+        ptr = mmap(NULL, (size_t)rd->filesize, PROT_READ, MAP_SHARED, rd->fd, 0);
+        if(ptr == MAP_FAILED) return;
+#ifdef POSIX_MADV_SEQUENTIAL
+        posix_madvise(ptr, (size_t)rd->filesize, POSIX_MADV_SEQUENTIAL);
+#endif
+        rd->map = (const char *)ptr;
+    }
+#endif
+}
+
+/* Unmap the file. The index is freed, unless it is kept in the cache. */
+void closePLXReader(PLXReader *rd)
+{
+    if(rd->idx != NULL && rd->idx != cachedindex) freePLXIndex(rd->idx);
+    rd->idx = NULL;
+    if(!rd->useindex) return;
+#ifdef _WIN32
+    if(rd->map != NULL) UnmapViewOfFile(rd->map);
+    if(rd->hmap != NULL) CloseHandle(rd->hmap);
+    if(rd->hfile != INVALID_HANDLE_VALUE) CloseHandle(rd->hfile);
+    rd->hmap = NULL;
+    rd->hfile = INVALID_HANDLE_VALUE;
+#else
+    if(rd->map != NULL) munmap((void *)rd->map, (size_t)rd->filesize);
+    if(rd->fd >= 0) close(rd->fd);
+    rd->fd = -1;
+#endif
+    rd->map = NULL;
+}
+
+/* Timestamp of the last sample of a block. The end of a continuous block
+ * is ts + (nbuf-1)*ADFrequency/ChanADFreq, rounded up. */
+UINT64_T blockEndPLX(const struct PL_DataBlockHeader *dbh, int ADFrequency, int *ChanADFreq, int nslchan)
+{
+    UINT64_T te;
+    int nbuf, freq;
+    
+    te = MAKETS(dbh->UpperByteOf5ByteTimestamp, dbh->TimeStamp);
+    nbuf = dbh->NumberOfWaveforms * dbh->NumberOfWordsInWaveform;
+    if(dbh->Type == PL_ADDataType && nbuf > 1 && nbuf <= MAX_DBH_WORDS)
+    {
+        freq = (dbh->Channel >= 0 && dbh->Channel < nslchan
+                && ChanADFreq[dbh->Channel] > 0) ? ChanADFreq[dbh->Channel] : ADFrequency;
+        te += ((UINT64_T)(nbuf-1)*ADFrequency + freq - 1) / freq;
+    }
+    return te;
+}
+
+/* Timestamp of a time in seconds, rounded to the nearest tick: the times computed
+ * from sample indices, (i-1)/Fs, can be just below the tick of the sample. */
+UINT64_T timeToTickPLX(double t, int ADFrequency)
+{
+    return (t > 0) ? (UINT64_T)floor(t * ADFrequency + 0.5) : 0;
+}
+
+/* Compute the running maximum of the block end times and the running
+ * minimum of the block start times, for each group of blocks. */
+int groupPLXIndex(PLXIndex *idx, int ADFrequency, int *ChanADFreq, int nslchan)
+{
+    UINT64_T g, i, i0, i1, ts, te, mx = 0, mn = (UINT64_T)-1;
+    struct PL_DataBlockHeader *dbh;
+
+    idx->ngroups = (idx->n + PLX_INDEX_GROUP - 1) / PLX_INDEX_GROUP;
+    idx->maxend   = (UINT64_T *)mxMalloc((size_t)MAX(idx->ngroups,1)*sizeof(UINT64_T));
+    idx->minstart = (UINT64_T *)mxMalloc((size_t)MAX(idx->ngroups,1)*sizeof(UINT64_T));
+    if(idx->maxend == NULL || idx->minstart == NULL) return 5;
+
+    for(g = 0; g < idx->ngroups; g++)
+    {
+        i0 = g*PLX_INDEX_GROUP;
+        i1 = MIN(i0+PLX_INDEX_GROUP, idx->n);
+        for(i = i0; i < i1; i++)
+        {
+            te = blockEndPLX(&idx->blocks[i].dbh, ADFrequency, ChanADFreq, nslchan);
+            mx = MAX(mx, te);
+        }
+        idx->maxend[g] = mx;
+    }
+    for(g = idx->ngroups; g-- > 0; )
+    {
+        i0 = g*PLX_INDEX_GROUP;
+        i1 = MIN(i0+PLX_INDEX_GROUP, idx->n);
+        for(i = i0; i < i1; i++)
+        {
+            dbh = &idx->blocks[i].dbh;
+            ts = MAKETS(dbh->UpperByteOf5ByteTimestamp, dbh->TimeStamp);
+            mn = MIN(mn, ts);
+        }
+        idx->minstart[g] = mn;
+    }
+    return 0;
+}
+
+/* Load the index from the sidecar file, if it matches the PLX file. */
+PLXIndex *loadPLXIndex(PLXReader *rd, UINT64_T datastart)
+{
+    char *iname, magic[8];
+    UINT64_T hdr[4];
+    FILE *fi;
+    PLXIndex *idx = NULL;
+
+    iname = (char *)mxMalloc(strlen(rd->fname) + strlen(PLX_INDEX_EXT) + 1);
+    if(iname == NULL) return NULL;
+    strcpy(iname, rd->fname);
+    strcat(iname, PLX_INDEX_EXT);
+    fi = fopen(iname, "rb");
+    mxFree(iname);
+    if(fi == NULL) return NULL;
+
+    /* Header: magic, file size, file time, data start, number of blocks */
+    if(fread(magic, 1, 8, fi) == 8 && strncmp(magic, PLX_INDEX_MAGIC, 8) == 0
+            && fread(hdr, sizeof(UINT64_T), 4, fi) == 4
+            && hdr[0] == rd->filesize && hdr[1] == rd->filetime && hdr[2] == datastart
+            && hdr[3]*sizeof(struct PL_DataBlockHeader) <= rd->filesize)
+    {
+        idx = (PLXIndex *)mxCalloc(1, sizeof(PLXIndex));
+        if(idx != NULL)
+        {
+            idx->n = hdr[3];
+            idx->blocks = (PLXIndexEntry *)mxMalloc((size_t)MAX(idx->n,1)*sizeof(PLXIndexEntry));
+            if(idx->blocks == NULL
+                    || fread(idx->blocks, sizeof(PLXIndexEntry), (size_t)idx->n, fi) != idx->n)
+            {
+                freePLXIndex(idx);
+                idx = NULL;
+            }
+        }
+    }
+    fclose(fi);
+    return idx;
+}
+
+/* Save the index next to the PLX file (silently skipped if the folder is not writable). */
+void savePLXIndex(PLXReader *rd, PLXIndex *idx)
+{
+    char *iname, magic[8];
+    UINT64_T hdr[4];
+    FILE *fi;
+    bool ok;
+
+    iname = (char *)mxMalloc(strlen(rd->fname) + strlen(PLX_INDEX_EXT) + 1);
+    if(iname == NULL) return;
+    strcpy(iname, rd->fname);
+    strcat(iname, PLX_INDEX_EXT);
+    fi = fopen(iname, "wb");
+    if(fi != NULL)
+    {
+        memset(magic, 0, 8);
+        strncpy(magic, PLX_INDEX_MAGIC, 8);
+        hdr[0] = idx->filesize;
+        hdr[1] = idx->filetime;
+        hdr[2] = idx->datastart;
+        hdr[3] = idx->n;
+        ok =   fwrite(magic, 1, 8, fi) == 8
+            && fwrite(hdr, sizeof(UINT64_T), 4, fi) == 4
+            && fwrite(idx->blocks, sizeof(PLXIndexEntry), (size_t)idx->n, fi) == idx->n;
+        fclose(fi);
+        if(!ok) remove(iname);
+    }
+    mxFree(iname);
+}
+
+/* Check the header of a data block. */
+bool validPLXBlock(const struct PL_DataBlockHeader *dbh)
+{
+    return (dbh->Type == PL_SingleWFType || dbh->Type == PL_ExtEventType
+        || dbh->Type == PL_ADDataType) && dbh->Channel >= 0
+        && dbh->NumberOfWaveforms >= 0 && dbh->NumberOfWordsInWaveform >= 0
+        && dbh->NumberOfWaveforms * dbh->NumberOfWordsInWaveform <= MAX_DBH_WORDS;
+}
+
+/* Scan the data block headers from the offset 'from', without reading the
+ * data. The scan stops after an invalid or incomplete block, which is kept
+ * in the index so that it is reported when it is reached.
+ * For a partial index (streaming), the valid blocks that end before 'wstart'
+ * are not indexed, and the scan stops at the first block that starts after
+ * 'until'. 'resume' is then set to the offset of the first block that ends
+ * at or after 'wstop' (where the next scan should start). */
+PLXIndex *buildPLXIndex(PLXReader *rd, UINT64_T from, UINT64_T wstart, UINT64_T wstop,
+        UINT64_T until, int ADFrequency, int *ChanADFreq, int nslchan, UINT64_T *resume)
+{
+    PLXIndex *idx;
+    PLXIndexEntry *blocks;
+    struct PL_DataBlockHeader dbh;
+    UINT64_T pos, nalloc, ts, te;
+    int nbuf;
+    bool valid, partial;
+
+    partial = (resume != NULL);
+    idx = (PLXIndex *)mxCalloc(1, sizeof(PLXIndex));
+    if(idx == NULL) return NULL;
+    /* Initial guess: one block for each kilobyte of data */
+    nalloc = partial ? 1024 : MAX((rd->filesize - MIN(from, rd->filesize)) / 1024, 1024);
+    idx->blocks = (PLXIndexEntry *)mxMalloc((size_t)nalloc*sizeof(PLXIndexEntry));
+    if(idx->blocks == NULL) { freePLXIndex(idx); return NULL; }
+
+    if(rd->map == NULL && PLX_FSEEK(rd->fp, from, SEEK_SET) != 0)
+    {
+        freePLXIndex(idx);
+        return NULL;
+    }
+    pos = from;
+    if(partial) *resume = (UINT64_T)-1;
+    while(pos + sizeof(dbh) <= rd->filesize)
+    {
+        if(rd->map != NULL) memcpy(&dbh, rd->map + pos, sizeof(dbh));
+        else if(fread(&dbh, sizeof(dbh), 1, rd->fp) != 1) break;
+
+        nbuf = dbh.NumberOfWaveforms * dbh.NumberOfWordsInWaveform;
+        valid = validPLXBlock(&dbh);
+        if(partial && valid)
+        {
+            ts = MAKETS(dbh.UpperByteOf5ByteTimestamp, dbh.TimeStamp);
+            if(ts >= until) break;
+            te = blockEndPLX(&dbh, ADFrequency, ChanADFreq, nslchan);
+            if(te >= wstop && *resume == (UINT64_T)-1) *resume = pos;
+            if(te < wstart)
+            {
+                pos += sizeof(dbh) + nbuf*sizeof(short);
+                if(rd->map == NULL && nbuf > 0 && PLX_FSEEK(rd->fp, nbuf*sizeof(short), SEEK_CUR) != 0) break;
+                continue;
+            }
+        } else if(partial && *resume == (UINT64_T)-1) *resume = pos;
+
+        if(idx->n == nalloc)
+        {
+            nalloc *= 2;
+            blocks = (PLXIndexEntry *)mxRealloc(idx->blocks, (size_t)nalloc*sizeof(PLXIndexEntry));
+            if(blocks == NULL) { freePLXIndex(idx); return NULL; }
+            idx->blocks = blocks;
+        }
+        idx->blocks[idx->n].offset = pos;
+        idx->blocks[idx->n].dbh = dbh;
+        idx->n++;
+        if(!valid) break;
+
+        pos += sizeof(dbh) + nbuf*sizeof(short);
+        if(rd->map == NULL && nbuf > 0 && PLX_FSEEK(rd->fp, nbuf*sizeof(short), SEEK_CUR) != 0) break;
+    }
+    /* Nothing left to read after this range: resume at the end of the scan */
+    if(partial && *resume == (UINT64_T)-1) *resume = MIN(pos, rd->filesize);
+    idx->datastart = from;
+    idx->filesize = rd->filesize;
+    idx->filetime = rd->filetime;
+    return idx;
+}
+
+/* Get the index of the file: from the memory cache, from the sidecar
+ * file, or by scanning the file. The new index replaces the cached one. */
+int getPLXIndex(PLXReader *rd, UINT64_T datastart, int ADFrequency, int *ChanADFreq, int nslchan)
+{
+    PLXIndex *idx;
+    bool fromfile = false;
+
+    if(rd->idx != NULL) return 0;
+    idx = cachedindex;
+    if(idx != NULL && strcmp(idx->fname, rd->fname) == 0 && idx->filesize == rd->filesize
+            && idx->filetime == rd->filetime && idx->datastart == datastart)
+    {
+        rd->idx = idx;
+        return 0;
+    }
+    idx = NULL;
+    if(rd->indexfile)
+    {
+        idx = loadPLXIndex(rd, datastart);
+        fromfile = (idx != NULL);
+    }
+    if(idx == NULL) idx = buildPLXIndex(rd, datastart, 0, (UINT64_T)-1, (UINT64_T)-1,
+            ADFrequency, ChanADFreq, nslchan, NULL);
+    if(idx == NULL) return 5;
+    idx->datastart = datastart;
+    idx->filesize = rd->filesize;
+    idx->filetime = rd->filetime;
+    idx->fname = (char *)mxMalloc(strlen(rd->fname) + 1);
+    if(idx->fname == NULL) { freePLXIndex(idx); return 5; }
+    strcpy(idx->fname, rd->fname);
+    if(groupPLXIndex(idx, ADFrequency, ChanADFreq, nslchan) != 0) { freePLXIndex(idx); return 5; }
+    if(rd->indexfile && !fromfile) savePLXIndex(rd, idx);
+
+    /* Keep the new index in memory for the next calls. */
+    clearPLXIndexCache();
+    mexMakeMemoryPersistent(idx);
+    mexMakeMemoryPersistent(idx->fname);
+    mexMakeMemoryPersistent(idx->blocks);
+    mexMakeMemoryPersistent(idx->maxend);
+    mexMakeMemoryPersistent(idx->minstart);
+    cachedindex = idx;
+    mexAtExit(clearPLXIndexCache);
+    rd->idx = idx;
+    return 0;
+}
+
+/* Position the reader on the first data block that may overlap [start, stop).
+ * Without index, this simply rewinds the file to the start of the data. */
+int seekPLXData(PLXReader *rd, UINT64_T datastart, UINT64_T start, UINT64_T stop,
+        int ADFrequency, int *ChanADFreq, int nslchan)
+{
+    UINT64_T lo, hi, mid;
+    int retval;
+
+    if(!rd->useindex) return (fseek(rd->fp, (long)datastart, SEEK_SET) != 0) ? 9 : 0;
+    retval = getPLXIndex(rd, datastart, ADFrequency, ChanADFreq, nslchan);
+    if(retval != 0) return retval;
+
+    /* First group with a block ending at or after 'start' */
+    lo = 0; hi = rd->idx->ngroups;
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo)/2;
+        if(rd->idx->maxend[mid] < start) lo = mid + 1;
+        else hi = mid;
+    }
+    rd->next = lo*PLX_INDEX_GROUP;
+    /* First group after which all the blocks start at or after 'stop' */
+    hi = rd->idx->ngroups;
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo)/2;
+        if(rd->idx->minstart[mid] < stop) lo = mid + 1;
+        else hi = mid;
+    }
+    rd->last = MIN(lo*PLX_INDEX_GROUP, rd->idx->n);
+    return 0;
+}
+
+/* Read the next data block header. Returns false at the end of the data.
+ * With the index, blocks of types that are not requested are skipped. */
+bool nextPLXBlock(PLXReader *rd, struct PL_DataBlockHeader *dbh)
+{
+    PLXIndexEntry *e;
+
+    if(!rd->useindex) return (fread(dbh, sizeof(*dbh), 1, rd->fp) == 1);
+    while(rd->next < rd->last)
+    {
+        e = &rd->idx->blocks[rd->next++];
+        if((e->dbh.Type == PL_SingleWFType || e->dbh.Type == PL_ExtEventType
+            || e->dbh.Type == PL_ADDataType) && !(rd->typemask & (1 << e->dbh.Type)))
+            continue;
+        *dbh = e->dbh;
+        rd->offset = e->offset;
+        return true;
+    }
+    return false;
+}
+
+/* Offset in the file, reported in the warnings */
+long tellPLXBlock(PLXReader *rd)
+{
+    if(!rd->useindex) return ftell(rd->fp);
+    return (long)(rd->offset + sizeof(struct PL_DataBlockHeader));
+}
+
+/* Get the data of the current block: pointer in the mapped file, or copy
+ * in 'buf'. Returns NULL if the block is incomplete. If 'skip' is true,
+ * the data is not needed and it is not read when using the index. */
+const short *readPLXBlockData(PLXReader *rd, int nbuf, short *buf, bool skip)
+{
+    UINT64_T pos;
+
+    if(!rd->useindex)
+        return (fread(buf, sizeof(short), nbuf, rd->fp) == (size_t)nbuf) ? buf : NULL;
+    pos = rd->offset + sizeof(struct PL_DataBlockHeader);
+    if(pos + nbuf*sizeof(short) > rd->filesize) return NULL;
+    if(skip || nbuf == 0) return buf;
+    if(rd->map != NULL) return (const short *)(rd->map + pos);
+    if(PLX_FSEEK(rd->fp, pos, SEEK_SET) != 0) return NULL;
+    return (fread(buf, sizeof(short), nbuf, rd->fp) == (size_t)nbuf) ? buf : NULL;
+}
+
+int tallyrange(mxArray *datacounts[5], PLXReader *rd,
         UINT64_T start, UINT64_T stop, int ADFrequency, int *ChanADFreq)
 {
     struct PL_DataBlockHeader dbh;
@@ -281,8 +835,7 @@ int tallyrange(mxArray *datacounts[5], FILE* fp,
     for(i = 0; i < nslchan; i++) { psl[i] = 0; psf[i] = 0; }
 
     if(stop<start) return 0;
-    if(fread(&dbh, sizeof(dbh), 1, fp) != 1) return 0;
-    while(!feof(fp))
+    while(nextPLXBlock(rd, &dbh))
     {
         if(!(dbh.Type == PL_SingleWFType || dbh.Type == PL_ExtEventType
             || dbh.Type == PL_ADDataType)) return 1;
@@ -298,7 +851,7 @@ int tallyrange(mxArray *datacounts[5], FILE* fp,
         /* This now returns '0' instead of '5'. This effectively removes it
          * from the data count, so it isn't read later, rather than crashing.
          */
-        if(fread(&buf[0], sizeof(short), nbuf, fp) != nbuf) return 0;
+        if(readPLXBlockData(rd, nbuf, buf, true) == NULL) return 0;
         if(dbh.Type == PL_SingleWFType)
         {
             if(ts >= start && ts <stop)
@@ -355,7 +908,6 @@ int tallyrange(mxArray *datacounts[5], FILE* fp,
                 psl[dbh.Channel] += ntw;
             }
         }
-        if(fread(&dbh, sizeof(dbh), 1, fp) != 1) break;
     }
     if(current_ts != NULL) mxFree(current_ts);
     if(current_fn != NULL) mxFree(current_fn);
@@ -363,7 +915,7 @@ int tallyrange(mxArray *datacounts[5], FILE* fp,
     return 0;
 }
 
-int readPLXData(mxArray *plx, FILE* fp, bool readtypes[5], int numchanin[5],
+int readPLXData(mxArray *plx, PLXReader *rd, bool readtypes[5], int numchanin[5],
         int *channels[5], UINT64_T start, UINT64_T stop,
         int first, int last, bool switches[5])
 {
@@ -393,6 +945,7 @@ int readPLXData(mxArray *plx, FILE* fp, bool readtypes[5], int numchanin[5],
     int ntw, ntr, nbuf, current_fn;
     UINT64_T ts, current_ts;
     short buf[MAX_DBH_WORDS];
+    const short *wf;
     
     lastts = (UINT64_T)mxGetScalar(mxGetField(plx, 0, "LastTimestamp"));
     
@@ -530,12 +1083,18 @@ int readPLXData(mxArray *plx, FILE* fp, bool readtypes[5], int numchanin[5],
         }
     }
     
+    /* Only the requested block types need to be read through the index. */
+    rd->typemask = (readtypes[0] ? (1 << PL_SingleWFType) : 0)
+                 | (readtypes[2] ? (1 << PL_ExtEventType) : 0)
+                 | (readtypes[3] ? (1 << PL_ADDataType)   : 0);
+    
     /* If a start or stop was specified, then redo tally for restricted time range. */
     datastart = (unsigned int)mxGetScalar(mxGetField(plx, 0, "DataStartLocation"));
     if(switches[0] || switches[1])
     {
-        if(fseek(fp, datastart, SEEK_SET) != 0) return 9;
-        retval = tallyrange(datacounts, fp, start, stop, ADFrequency, ChanADFreq);
+        retval = seekPLXData(rd, datastart, start, stop, ADFrequency, ChanADFreq, maxchans[3]);
+        if(retval != 0) return retval;
+        retval = tallyrange(datacounts, rd, start, stop, ADFrequency, ChanADFreq);
         if(retval != 0) return 100+retval;
     }
     
@@ -823,12 +1382,12 @@ int readPLXData(mxArray *plx, FILE* fp, bool readtypes[5], int numchanin[5],
     /* Stop here if the time span is zero (or negative) */
     if(stop<start) return 0;
     
-    /* Rewind back to the start of the data. */
-    if(fseek(fp, datastart, SEEK_SET) != 0) return 9;
+    /* Rewind back to the start of the data (or of the time range). */
+    retval = seekPLXData(rd, datastart, start, stop, ADFrequency, ChanADFreq, maxchans[3]);
+    if(retval != 0) return retval;
     
     /* Lets actually read the data now. */
-    if(fread(&dbh, sizeof(dbh), 1, fp) != 1) return 0;
-    while(!feof(fp))
+    while(nextPLXBlock(rd, &dbh))
     {
         if(!(dbh.Type == PL_SingleWFType || dbh.Type == PL_ExtEventType
             || dbh.Type == PL_ADDataType)) return 101;
@@ -844,14 +1403,14 @@ int readPLXData(mxArray *plx, FILE* fp, bool readtypes[5], int numchanin[5],
          * This warning should be a duplicate of the previous warning, but
          * I'm leaving it in just in case.
          */
-        if(fread(&buf[0], sizeof(short), nbuf, fp) != nbuf)
+        if((wf = readPLXBlockData(rd, nbuf, buf, false)) == NULL)
         {
             mexWarnMsgIdAndTxt("readPLXFile:readData:incompleteDataBlock",
                     "Incomplete data block:\n(type: %d, channel: %d, "
                     "timestamp: (%d,%d), offset: 0x%X).\n"
                     "Skipping this and all following data blocks.",
                     dbh.Type, dbh.Channel, dbh.UpperByteOf5ByteTimestamp,
-                    dbh.TimeStamp, ftell(fp));
+                    dbh.TimeStamp, tellPLXBlock(rd));
             return 0;
         }
     
@@ -891,7 +1450,7 @@ int readPLXData(mxArray *plx, FILE* fp, bool readtypes[5], int numchanin[5],
                         spikeunits[dbh.Channel-1][n+i] = (unsigned char)dbh.Unit;
                     }
                     for(i = 0; i < MIN(nbuf,npw*ntw); i++)
-                        spikewaves[dbh.Channel-1][n*npw+i] = buf[i];
+                        spikewaves[dbh.Channel-1][n*npw+i] = wf[i];
                     ptrs[0][(dbh.Channel-1)*maxchans[4]+dbh.Unit]++;
                     ptrs[1][(dbh.Channel-1)*maxchans[4]+dbh.Unit]+=ntw;
                 }
@@ -985,13 +1544,12 @@ int readPLXData(mxArray *plx, FILE* fp, bool readtypes[5], int numchanin[5],
                     } else frags[dbh.Channel][nf] += ntr;
 
                     for(i = 0; i < MIN(ntr,nbuf-m); i++)
-                        continuous[dbh.Channel][n+i] = buf[m+i];
+                        continuous[dbh.Channel][n+i] = wf[m+i];
                     ptrs[3][dbh.Channel] += ntr;
                 }
                 numread[3][dbh.Channel] += ntw;
             }
         }
-        if(fread(&dbh, sizeof(dbh), 1, fp) != 1) break;
     }
     
     /* Clear memory used */
@@ -1024,7 +1582,290 @@ int readPLXData(mxArray *plx, FILE* fp, bool readtypes[5], int numchanin[5],
     return 0;
 }
 
-int tally(mxArray *datacounts[5], FILE* fp, struct PL_FileHeader fh,
+/* DENSE CONTINUOUS DATA
+ *
+ * The continuous channels are decoded directly into one [nChannels x nTime]
+ * matrix (int16, or single in Volts), instead of per-channel fragments.
+ * Column k holds the samples at times [t0 + k/freq, t0 + (k+1)/freq), with
+ * t0 = 'start' (or 0). Gaps between fragments are left at zero. When
+ * streaming, the grid t0 is fixed when the stream is opened, and each read
+ * returns the columns [col1, col1+ncols) of this grid.
+ * The range of the block index is split in chunks of PLX_DENSE_CHUNK blocks,
+ * decoded in parallel from the memory mapped file: the blocks of different
+ * chunks write to different samples of the output matrix.
+ */
+typedef struct
+{
+    int nrows;          /* Number of channels (rows) */
+    INT64_T ncols;      /* Number of samples (columns), -1 if not known yet */
+    INT64_T t0;         /* Timestamp of the column 0 (ticks) */
+    INT64_T col1;       /* First column of the output matrix */
+    INT64_T freq;       /* Sampling frequency of the channels (Hz) */
+    INT64_T adfreq;     /* Timestamp frequency (Hz) */
+    int nmap;           /* Size of rowmap */
+    int *rowmap;        /* Row of each channel number, -1 if not read */
+    float *scale;       /* Conversion to Volts for each row */
+    INT16_T *out16;     /* Output matrix (int16) */
+    float *out32;       /* Output matrix (single, scaled) */
+} PLXDense;
+
+/* Column range [col0, col0+n) of the output matrix for the samples of a block. */
+static int denseBlockRange(const PLXDense *dd, UINT64_T ts, int nbuf, INT64_T *col0, int *j0)
+{
+    INT64_T x0, jmin = 0, jmax = nbuf;
+
+    /* Sample j is in column ((ts-t0)*freq + j*adfreq)/adfreq of the grid */
+    x0 = ((INT64_T)ts - dd->t0) * dd->freq - dd->col1 * dd->adfreq;
+    if(x0 < 0) jmin = (-x0 + dd->adfreq - 1) / dd->adfreq;
+    if(jmax <= jmin) return 0;
+    *col0 = (x0 + jmin * dd->adfreq) / dd->adfreq;
+    if(dd->ncols >= 0)
+    {
+        if(*col0 >= dd->ncols) return 0;
+        jmax = MIN(jmax, jmin + dd->ncols - *col0);
+    }
+    *j0 = (int)jmin;
+    return (int)(jmax - jmin);
+}
+
+/* Copy (and scale) the samples of one block in its row of the output matrix. */
+static void denseDecodeBlock(const PLXDense *dd, const struct PL_DataBlockHeader *dbh, const short *wf)
+{
+    int i, j0, n, row;
+    INT64_T col0;
+    size_t k, stride;
+    float s;
+
+    if(dbh->Channel < 0 || dbh->Channel >= dd->nmap) return;
+    row = dd->rowmap[dbh->Channel];
+    if(row < 0) return;
+    n = denseBlockRange(dd, MAKETS(dbh->UpperByteOf5ByteTimestamp, dbh->TimeStamp),
+            dbh->NumberOfWaveforms * dbh->NumberOfWordsInWaveform, &col0, &j0);
+    stride = (size_t)dd->nrows;
+    k = (size_t)row + (size_t)col0 * stride;
+    if(dd->out32 != NULL)
+    {
+        s = dd->scale[row];
+        for(i = 0; i < n; i++, k += stride) dd->out32[k] = s * (float)wf[j0+i];
+    } else
+        for(i = 0; i < n; i++, k += stride) dd->out16[k] = wf[j0+i];
+}
+
+int readPLXDense(mxArray *plx, PLXReader *rd, int numchanin, int *channels,
+        INT64_T t0, INT64_T col1, INT64_T ncols, INT64_T stop, bool scaled)
+{
+    PLXDense dd;
+    mxArray *mxptr, *mxout;
+    struct PL_DataBlockHeader dbh;
+    const PLXIndexEntry *e;
+    const short *wf;
+    short buf[MAX_DBH_WORDS];
+    double *pch, version, maxmv, bits, gain, preamp, mv;
+    int i, j, c, nbuf, nhead, ADFrequency, *ChanADFreq, *headmap, nchunks, ic, nincomplete = 0;
+    INT64_T col0;
+    UINT64_T datastart, i0, i1, wstart, wstop;
+    bool incomplete = false;
+
+    ADFrequency = (int)mxGetScalar(mxGetField(plx, 0, "ADFrequency"));
+    datastart = (UINT64_T)mxGetScalar(mxGetField(plx, 0, "DataStartLocation"));
+    mxptr = mxGetField(plx, 0, "ContinuousChannels");
+    if(mxptr == NULL || !mxIsStruct(mxptr)) return 10;
+    nhead = (int)mxGetNumberOfElements(mxptr);
+
+    /* Map channel numbers to headers, get the sampling frequencies. */
+    dd.nmap = 0;
+    for(j = 0; j < nhead; j++)
+        dd.nmap = MAX(dd.nmap, (int)mxGetScalar(mxGetField(mxptr, j, "Channel")) + 1);
+    for(i = 0; i < numchanin; i++) dd.nmap = MAX(dd.nmap, channels[i] + 1);
+    headmap    = (int *)mxMalloc(MAX(dd.nmap,1)*sizeof(int));
+    dd.rowmap  = (int *)mxMalloc(MAX(dd.nmap,1)*sizeof(int));
+    ChanADFreq = (int *)mxMalloc(MAX(dd.nmap,1)*sizeof(int));
+    if(headmap == NULL || dd.rowmap == NULL || ChanADFreq == NULL) return 5;
+    for(c = 0; c < dd.nmap; c++) { headmap[c] = -1; dd.rowmap[c] = -1; ChanADFreq[c] = ADFrequency; }
+    for(j = 0; j < nhead; j++)
+    {
+        c = (int)mxGetScalar(mxGetField(mxptr, j, "Channel"));
+        if(c < 0) continue;
+        headmap[c] = j;
+        ChanADFreq[c] = (int)mxGetScalar(mxGetField(mxptr, j, "ADFrequency"));
+    }
+
+    /* Rows: channels listed, or all the channels with a header. */
+    dd.nrows = (numchanin > 0 && channels != NULL) ? numchanin : nhead;
+    mxout = mxCreateDoubleMatrix(dd.nrows, 1, mxREAL);
+    pch = mxGetPr(mxout);
+    for(i = 0; i < dd.nrows; i++)
+    {
+        if(numchanin > 0 && channels != NULL) pch[i] = channels[i];
+        else pch[i] = mxGetScalar(mxGetField(mxptr, i, "Channel"));
+        c = (int)pch[i];
+        if(c >= 0 && c < dd.nmap && dd.rowmap[c] < 0) dd.rowmap[c] = i;
+    }
+
+    /* All the rows must have the same sampling frequency. */
+    dd.freq = 0;
+    for(i = 0; i < dd.nrows; i++)
+    {
+        c = (int)pch[i];
+        if(c < 0 || c >= dd.nmap || headmap[c] < 0) continue;
+        if(dd.freq == 0) dd.freq = ChanADFreq[c];
+        else if(dd.freq != ChanADFreq[c]) return 11;
+    }
+    if(dd.freq <= 0) dd.freq = ADFrequency;
+    dd.adfreq = ADFrequency;
+    dd.t0 = t0;
+    dd.col1 = col1;
+    /* Number of columns: from the end of the time window, or up to the last sample read. */
+    if(ncols < 0 && stop >= 0)
+        ncols = MAX(0, ((stop - t0) * dd.freq + dd.adfreq/2) / dd.adfreq - col1);
+    dd.ncols = ncols;
+    wstart = (UINT64_T)MAX(0, t0 + (col1 * dd.adfreq) / dd.freq);
+    wstop = (ncols >= 0) ? (UINT64_T)(t0 + ((col1 + ncols) * dd.adfreq + dd.freq - 1) / dd.freq) : (UINT64_T)-1;
+
+    /* Conversion factors to Volts (same as the Plexon SDK, which returns mV). */
+    dd.scale = (float *)mxCalloc(MAX(dd.nrows,1), sizeof(float));
+    if(dd.scale == NULL) return 5;
+    version = mxGetScalar(mxGetField(plx, 0, "Version"));
+    maxmv = mxGetScalar(mxGetField(plx, 0, "ContMaxMagnitudeMV"));
+    bits = mxGetScalar(mxGetField(plx, 0, "BitsPerContSample"));
+    for(i = 0; i < dd.nrows; i++)
+    {
+        c = (int)pch[i];
+        if(c < 0 || c >= dd.nmap || headmap[c] < 0) continue;
+        gain   = mxGetScalar(mxGetField(mxptr, headmap[c], "ADGain"));
+        preamp = mxGetScalar(mxGetField(mxptr, headmap[c], "PreAmpGain"));
+        if(gain * preamp == 0) continue;
+        if(version >= 103) mv = maxmv / (0.5 * pow(2.0, bits) * gain * preamp);
+        else if(version >= 102) mv = 5000.0 / (2048.0 * gain * preamp);
+        else mv = 5000.0 / (2048.0 * gain * 1000.0);
+        dd.scale[i] = (float)(mv / 1000.0);
+    }
+
+    /* Only the continuous blocks are read. */
+    rd->typemask = (1 << PL_ADDataType);
+    i = seekPLXData(rd, datastart, wstart, wstop, ADFrequency, ChanADFreq, dd.nmap);
+    if(i != 0) return i;
+    i0 = rd->next;
+    i1 = rd->last;
+
+    /* The index stops after the first invalid block: report it if it is in the range. */
+    if(i1 > i0)
+    {
+        e = &rd->idx->blocks[i1-1];
+        nbuf = e->dbh.NumberOfWaveforms * e->dbh.NumberOfWordsInWaveform;
+        if(!(e->dbh.Type == PL_SingleWFType || e->dbh.Type == PL_ExtEventType
+            || e->dbh.Type == PL_ADDataType)) return 101;
+        if(e->dbh.Channel < 0) return 102;
+        if(e->dbh.NumberOfWaveforms < 0 || e->dbh.NumberOfWordsInWaveform < 0
+            || nbuf > MAX_DBH_WORDS) return 103;
+    }
+
+    if(ncols < 0)
+    {
+        ncols = 0;
+        for(rd->next = i0; nextPLXBlock(rd, &dbh); )
+        {
+            if(dbh.Channel < 0 || dbh.Channel >= dd.nmap || dd.rowmap[dbh.Channel] < 0) continue;
+            nbuf = denseBlockRange(&dd, MAKETS(dbh.UpperByteOf5ByteTimestamp, dbh.TimeStamp),
+                    dbh.NumberOfWaveforms * dbh.NumberOfWordsInWaveform, &col0, &j);
+            if(nbuf > 0) ncols = MAX(ncols, col0 + nbuf);
+        }
+    }
+    dd.ncols = ncols;
+
+    /* Allocate the output matrix (initialized at zero). */
+    if(scaled)
+    {
+        mxptr = mxCreateNumericMatrix(dd.nrows, (mwSize)ncols, mxSINGLE_CLASS, mxREAL);
+        dd.out32 = (float *)mxGetData(mxptr);
+        dd.out16 = NULL;
+    } else
+    {
+        mxptr = mxCreateNumericMatrix(dd.nrows, (mwSize)ncols, mxINT16_CLASS, mxREAL);
+        dd.out16 = (INT16_T *)mxGetData(mxptr);
+        dd.out32 = NULL;
+    }
+    if(mxptr == NULL) return 533;
+
+    if(dd.nrows > 0 && ncols > 0)
+    {
+        if(rd->map != NULL)
+        {
+            /* Parallel decoding of chunks of blocks, directly from the mapped file.
+             * The incomplete blocks are counted by each thread, and summed at the end. */
+            nchunks = (int)((i1 - i0 + PLX_DENSE_CHUNK - 1) / PLX_DENSE_CHUNK);
+#ifdef _OPENMP
+            #pragma omp parallel for schedule(dynamic,1) private(e, nbuf) reduction(+:nincomplete)
+#endif
+            for(ic = 0; ic < nchunks; ic++)
+            {
+                UINT64_T k, kend = MIN(i1, i0 + (UINT64_T)(ic+1)*PLX_DENSE_CHUNK);
+                for(k = i0 + (UINT64_T)ic*PLX_DENSE_CHUNK; k < kend; k++)
+                {
+                    e = &rd->idx->blocks[k];
+                    if(e->dbh.Type != PL_ADDataType) continue;
+                    nbuf = e->dbh.NumberOfWaveforms * e->dbh.NumberOfWordsInWaveform;
+                    if(nbuf <= 0 || nbuf > MAX_DBH_WORDS) continue;
+                    if(e->offset + sizeof(struct PL_DataBlockHeader) + nbuf*sizeof(short) > rd->filesize)
+                    {
+                        nincomplete++;
+                        continue;
+                    }
+                    denseDecodeBlock(&dd, &e->dbh,
+                            (const short *)(rd->map + e->offset + sizeof(struct PL_DataBlockHeader)));
+                }
+            }
+            incomplete = (nincomplete > 0);
+        } else
+        {
+            /* File not mapped: sequential reading through the index. */
+            for(rd->next = i0; nextPLXBlock(rd, &dbh); )
+            {
+                nbuf = dbh.NumberOfWaveforms * dbh.NumberOfWordsInWaveform;
+                if(nbuf <= 0 || nbuf > MAX_DBH_WORDS) continue;
+                if((wf = readPLXBlockData(rd, nbuf, buf, false)) == NULL)
+                {
+                    incomplete = true;
+                    break;
+                }
+                denseDecodeBlock(&dd, &dbh, wf);
+            }
+        }
+    }
+    if(incomplete)
+        mexWarnMsgIdAndTxt("readPLXFile:readDense:incompleteDataBlock",
+                "Incomplete data block at the end of the file: skipped.");
+
+    /* Channels listed more than once: copy the first row. */
+    for(i = 0; i < dd.nrows; i++)
+    {
+        c = (int)pch[i];
+        if(c < 0 || c >= dd.nmap || dd.rowmap[c] < 0 || dd.rowmap[c] == i) continue;
+        for(col0 = 0; col0 < ncols; col0++)
+        {
+            if(scaled) dd.out32[i + col0*dd.nrows] = dd.out32[dd.rowmap[c] + col0*dd.nrows];
+            else       dd.out16[i + col0*dd.nrows] = dd.out16[dd.rowmap[c] + col0*dd.nrows];
+        }
+    }
+
+    if(    mxAddField(plx, "ContinuousData")          < 0
+        || mxAddField(plx, "ContinuousDataChannels")  < 0
+        || mxAddField(plx, "ContinuousDataStart")     < 0
+        || mxAddField(plx, "ContinuousDataFrequency") < 0) return 10;
+    mxSetField(plx, 0, "ContinuousData", mxptr);
+    mxSetField(plx, 0, "ContinuousDataChannels", mxout);
+    mxSetField(plx, 0, "ContinuousDataStart",
+            mxCreateDoubleScalar((double)dd.t0 + (double)(dd.col1 * dd.adfreq) / (double)dd.freq));
+    mxSetField(plx, 0, "ContinuousDataFrequency", mxCreateDoubleScalar((double)dd.freq));
+
+    mxFree(headmap);
+    mxFree(dd.rowmap);
+    mxFree(dd.scale);
+    mxFree(ChanADFreq);
+    return 0;
+}
+
+int tally(mxArray *datacounts[5], PLXReader *rd, struct PL_FileHeader fh,
     int maxchans[3], bool fullread, int ADFrequency, int *ChanADFreq)
 {
     struct PL_DataBlockHeader dbh;
@@ -1064,8 +1905,7 @@ int tally(mxArray *datacounts[5], FILE* fp, struct PL_FileHeader fh,
         if(nslchan > 0 && (current_ts == NULL || current_fn == NULL)) return 6;
         for(i = 0; i < nslchan; i++) current_ts[i] = -1;
         
-        if(fread(&dbh, sizeof(dbh), 1, fp) != 1) return 0;
-        while(!feof(fp))
+        while(nextPLXBlock(rd, &dbh))
         {
             if(!(dbh.Type == PL_SingleWFType || dbh.Type == PL_ExtEventType
                 || dbh.Type == PL_ADDataType)) return 1;
@@ -1076,7 +1916,7 @@ int tally(mxArray *datacounts[5], FILE* fp, struct PL_FileHeader fh,
             if(dbh.NumberOfWaveforms < 0 || dbh.NumberOfWordsInWaveform < 0
                 || nbuf > MAX_DBH_WORDS) return 3;
 
-            if(fread(&buf[0], sizeof(short), nbuf, fp) != nbuf) 
+            if(readPLXBlockData(rd, nbuf, buf, true) == NULL) 
             {
                 /* This now returns '0' instead of '5'. This effectively 
                  * removes it from the data count, so it isn't read later,
@@ -1087,7 +1927,7 @@ int tally(mxArray *datacounts[5], FILE* fp, struct PL_FileHeader fh,
                         "timestamp: (%d,%d), offset: 0x%X).\n"
                         "Ignoring this and all following data blocks.",
                         dbh.Type, dbh.Channel, dbh.UpperByteOf5ByteTimestamp,
-                        dbh.TimeStamp, ftell(fp));
+                        dbh.TimeStamp, tellPLXBlock(rd));
                 return 0;
             }
             if(dbh.Type == PL_SingleWFType)
@@ -1125,7 +1965,6 @@ int tally(mxArray *datacounts[5], FILE* fp, struct PL_FileHeader fh,
                 } else current_fn[dbh.Channel] += nbuf;
                 psl[dbh.Channel] += nbuf;
             }
-            if(fread(&dbh, sizeof(dbh), 1, fp) != 1) break;
         }
         if(current_ts != NULL) mxFree(current_ts);
         if(current_fn != NULL) mxFree(current_fn);
@@ -1425,7 +2264,7 @@ int buildSlowHeadStruct(mxArray *plx, struct PL_SlowChannelHeader *sh, int ver,
     return 0;
 }
 
-int scanPLXFile(mxArray *plx, FILE* fp, bool fullread)
+int scanPLXFile(mxArray *plx, PLXReader *rd, bool fullread)
 {
     struct PL_FileHeader fh;
     struct PL_ChanHeader *spchans;
@@ -1436,6 +2275,7 @@ int scanPLXFile(mxArray *plx, FILE* fp, bool fullread)
     int i, retval, *ChanADFreq, maxchans[3] = {0, 0, -1};
     unsigned int datastart;
     mxArray *datacounts[5];
+    FILE *fp = rd->fp;
     
     if(fread(&fh, sizeof(fh), 1, fp) != 1)
     {
@@ -1493,7 +2333,12 @@ int scanPLXFile(mxArray *plx, FILE* fp, bool fullread)
     datastart = ftell(fp);
     
     /* Count the number of data blocks in the file */
-    retval = tally(datacounts, fp, fh, maxchans, fullread, fh.ADFrequency, ChanADFreq);
+    if(fullread)
+    {
+        retval = seekPLXData(rd, datastart, 0, -1, fh.ADFrequency, ChanADFreq, maxchans[2]+1);
+        if(retval != 0) return retval;
+    }
+    retval = tally(datacounts, rd, fh, maxchans, fullread, fh.ADFrequency, ChanADFreq);
     if(retval != 0) return 100+retval;
     
     /* Build a MATLAB structure from the data in the file header. */
@@ -1542,37 +2387,480 @@ int scanPLXFile(mxArray *plx, FILE* fp, bool fullread)
     return 0;
 }
 
-void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+/* STREAMS
+ *
+ * A stream keeps its position in the file between calls, and reads the data
+ * by chunks of fixed duration:
+ *   plx = readPLXFileC(filename, 'open', ...)  : headers, and plx.Handle
+ *   plx = readPLXFileC('read', handle, dur)    : data of the next 'dur' seconds
+ *   readPLXFileC('close', handle)
+ * Only the blocks of the current chunk are indexed, so the memory used does
+ * not depend on the length of the recording. The stream keeps the offset of
+ * the first block that was not entirely read, assuming that the blocks are
+ * stored in the order of their end times (with a tolerance of
+ * PLX_STREAM_SLACK seconds). For each continuous channel, it also keeps the
+ * timestamp of the sample that would continue the last fragment read, to
+ * flag the fragments that continue from the previous chunk.
+ * The file is opened again by each read, and closed at the end of the read:
+ * it is not locked by the stream between the calls. The reads fail if the
+ * size or the modification time of the file changed.
+ */
+typedef struct
 {
-    bool fullread = false;
-    /* 0 = 'spikes', 1 = 'waves', 2 = 'events',
-     * 3 = 'continuous, 4 = 'units' */
+    char *fname;
+    FILE *fp;               /* Open file (only during a read) */
+    UINT64_T filesize;      /* Size and modification time when the stream was opened */
+    UINT64_T filetime;
+    PLXReader rd;
+    mxArray *plx;           /* Headers returned when the stream was opened */
     bool readtypes[5];
-    char *fname, *arg;
-    double start = 0, stop = 0, *range, *ptr;
-    int first = 1, last = 0, num = 1, *channels[5], numchanin[5];
-    UINT64_T starttick = 0, stoptick = -1;
-    bool switches[4], haveheader = false, havenum = false;
-    /* 0 = 'havestart', 1 = 'havestop',
-     * 2 = 'havefirst', 3 = 'havelast' */
-    const char helpstr[] = "For detailed help run: readPLXFileC('help')";
-    int i, n, ADFrequency, retval = 0;
-    int lastarg = -1, revnum;
-    long offset = 0;
-    
-    FILE* fp;
-    
-    /* Check that inputs and outputs are OK */
-    if(nrhs < 1)
-        mexErrMsgIdAndTxt("readPLXFile:usage",
-            "At least one input argument is required.\n%s", helpstr);
-    else if(!mxIsChar(prhs[0]))
-        mexErrMsgIdAndTxt("readPLXFile:usage",
-            "First argument must be a filename (string), 'help', or 'version'.\n%s", helpstr);
+    int numchanin[5];
+    int *channels[5];
+    bool dense, scaled;
+    UINT64_T offset;        /* Offset of the first data block to scan */
+    UINT64_T cursor;        /* Start of the next chunk (ticks) */
+    INT64_T t0, col;        /* Dense matrix: grid origin (ticks), next column */
+    int ADFrequency;
+    int nslchan;
+    int *ChanADFreq;
+    INT64_T *nextcont;      /* Next sample of each continuous channel (ticks*ChanADFreq) */
+} PLXStream;
+
+static PLXStream *streams[MAX_NUM_STREAMS];
+
+void closePLXStream(int h)
+{
+    PLXStream *st = streams[h];
+    int i;
     
-    if(nlhs > 1)
-        mexErrMsgIdAndTxt("readPLXFile:usage",
-            "Too many output arguments.\n%s", helpstr);
+    if(st == NULL) return;
+    closePLXReader(&st->rd);
+    if(st->fp != NULL) fclose(st->fp);
+    if(st->plx != NULL) mxDestroyArray(st->plx);
+    for(i = 0; i < 5; i++) if(st->channels[i] != NULL) mxFree(st->channels[i]);
+    if(st->ChanADFreq != NULL) mxFree(st->ChanADFreq);
+    if(st->nextcont   != NULL) mxFree(st->nextcont);
+    if(st->fname      != NULL) mxFree(st->fname);
+    mxFree(st);
+    streams[h] = NULL;
+}
+
+/* Called when the MEX-file is cleared. */
+void cleanupPLX(void)
+{
+    int h;
+    for(h = 0; h < MAX_NUM_STREAMS; h++) closePLXStream(h);
+    clearPLXIndexCache();
+}
+
+/* Replace the data counts of the headers with empty counts, with the
+ * dimensions expected by readPLXData (same as after a full read). */
+int resetPLXCounts(mxArray *plx)
+{
+    const char *fields[5] = {"SpikeTimestampCounts", "SpikeWaveformCounts",
+            "EventCounts", "ContSampleCounts", "ContSampleFragments"};
+    const char *heads[3] = {"SpikeChannels", "EventChannels", "ContinuousChannels"};
+    mxArray *mxptr;
+    int i, j, maxchans[3] = {0, 0, -1};
+    
+    for(i = 0; i < 3; i++)
+    {
+        mxptr = mxGetField(plx, 0, heads[i]);
+        if(mxptr == NULL || mxGetFieldNumber(mxptr, "Channel") < 0) continue;
+        for(j = 0; j < mxGetNumberOfElements(mxptr); j++)
+            maxchans[i] = MAX(maxchans[i], (int)mxGetScalar(mxGetField(mxptr, j, "Channel")));
+    }
+    for(i = 0; i < 5; i++)
+    {
+        if(mxGetFieldNumber(plx, fields[i]) < 0 && mxAddField(plx, fields[i]) < 0) return 6;
+        mxDestroyArray(mxGetField(plx, 0, fields[i]));
+    }
+    mxSetField(plx, 0, fields[0], mxCreateDoubleMatrix(MAX_NUM_UNITS+1, maxchans[0], mxREAL));
+    mxSetField(plx, 0, fields[1], mxCreateDoubleMatrix(MAX_NUM_UNITS+1, maxchans[0], mxREAL));
+    mxSetField(plx, 0, fields[2], mxCreateDoubleMatrix(1, maxchans[1], mxREAL));
+    mxSetField(plx, 0, fields[3], mxCreateDoubleMatrix(1, maxchans[2]+1, mxREAL));
+    mxSetField(plx, 0, fields[4], mxCreateDoubleMatrix(1, maxchans[2]+1, mxREAL));
+    return 0;
+}
+
+/* Create a stream from the headers, starting at 'start' (ticks). Returns the handle (>=1),
+ * or 0 if there are too many streams open. 'fp' is not kept open by the stream. */
+int openPLXStream(const mxArray *plx, FILE *fp, const char *fname, bool useindexcache,
+        bool readtypes[5], int numchanin[5], int *channels[5], bool dense, bool scaled, UINT64_T start)
+{
+    PLXStream *st;
+    mxArray *mxptr;
+    UINT64_T datastart;
+    int h, i, j, c;
+    
+    for(h = 0; h < MAX_NUM_STREAMS && streams[h] != NULL; h++);
+    if(h == MAX_NUM_STREAMS) return 0;
+    
+    st = (PLXStream *)mxCalloc(1, sizeof(PLXStream));
+    mexMakeMemoryPersistent(st);
+    st->fname = (char *)mxMalloc(strlen(fname) + 1);
+    mexMakeMemoryPersistent(st->fname);
+    strcpy(st->fname, fname);
+    st->plx = mxDuplicateArray(plx);
+    mexMakeArrayPersistent(st->plx);
+    for(i = 0; i < 5; i++)
+    {
+        st->readtypes[i] = readtypes[i];
+        st->numchanin[i] = numchanin[i];
+        if(channels[i] != NULL && numchanin[i] > 0)
+        {
+            st->channels[i] = (int *)mxMalloc(numchanin[i]*sizeof(int));
+            mexMakeMemoryPersistent(st->channels[i]);
+            memcpy(st->channels[i], channels[i], numchanin[i]*sizeof(int));
+        }
+    }
+    st->dense = dense;
+    st->scaled = scaled;
+    st->cursor = start;
+    st->t0 = (INT64_T)start;
+    st->col = 0;
+    
+    /* Sampling frequency of each continuous channel */
+    st->ADFrequency = (int)mxGetScalar(mxGetField(plx, 0, "ADFrequency"));
+    st->nslchan = (int)mxGetN(mxGetField(plx, 0, "ContSampleCounts"));
+    st->ChanADFreq = (int *)mxMalloc(MAX(st->nslchan,1)*sizeof(int));
+    st->nextcont = (INT64_T *)mxMalloc(MAX(st->nslchan,1)*sizeof(INT64_T));
+    mexMakeMemoryPersistent(st->ChanADFreq);
+    mexMakeMemoryPersistent(st->nextcont);
+    for(c = 0; c < st->nslchan; c++) { st->ChanADFreq[c] = st->ADFrequency; st->nextcont[c] = -1; }
+    mxptr = mxGetField(plx, 0, "ContinuousChannels");
+    for(j = 0; j < mxGetNumberOfElements(mxptr); j++)
+    {
+        c = (int)mxGetScalar(mxGetField(mxptr, j, "Channel"));
+        if(c >= 0 && c < st->nslchan)
+            st->ChanADFreq[c] = (int)mxGetScalar(mxGetField(mxptr, j, "ADFrequency"));
+    }
+    
+    /* Partial indices are built from the stream position. */
+    st->rd.useindex = true;
+    st->rd.indexfile = false;
+    openPLXReader(&st->rd, fp, st->fname);
+    /* Size of the file not available: the stream ends at the first read. */
+    st->rd.useindex = true;
+    
+    /* Start position: from the index of the file if it is already in memory. */
+    datastart = (UINT64_T)mxGetScalar(mxGetField(plx, 0, "DataStartLocation"));
+    st->offset = datastart;
+    if(useindexcache && cachedindex != NULL && strcmp(cachedindex->fname, st->fname) == 0
+            && cachedindex->filesize == st->rd.filesize && cachedindex->filetime == st->rd.filetime
+            && cachedindex->datastart == datastart)
+    {
+        st->rd.idx = cachedindex;
+        seekPLXData(&st->rd, datastart, start, (UINT64_T)-1, st->ADFrequency, st->ChanADFreq, st->nslchan);
+        st->offset = (st->rd.next < st->rd.last) ? cachedindex->blocks[st->rd.next].offset : st->rd.filesize;
+        st->rd.idx = NULL;
+    }
+    /* The file is opened again by each read. */
+    st->filesize = st->rd.filesize;
+    st->filetime = st->rd.filetime;
+    closePLXReader(&st->rd);
+    st->fp = NULL;
+    streams[h] = st;
+    mexAtExit(cleanupPLX);
+    return h+1;
+}
+
+/* Read the next 'duration' seconds of the stream (file open). */
+int readPLXStreamChunk(PLXStream *st, double duration, mxArray **out)
+{
+    mxArray *plx, *mxptr, *mxts, *mxfr;
+    PLXReader rd;
+    PLXIndex *idx;
+    struct PL_DataBlockHeader *dbh;
+    UINT64_T stop, wstart, wstop, until, resume, margin, tsf, tsl, k;
+    bool readtypes[5], switches[4] = {true, true, false, false}, b, atend;
+    int i, j, c, nf, retval = 0, minfreq;
+    INT64_T fn;
+    
+    plx = mxDuplicateArray(st->plx);
+    *out = plx;
+    if(duration < 0) duration = 0;
+    stop = st->cursor + (UINT64_T)(duration * st->ADFrequency + 0.5);
+    
+    /* Blocks that may contain samples of the chunk: the dense grid may start up to
+     * one sample before the cursor, and the blocks are written when they end. */
+    minfreq = st->ADFrequency;
+    for(c = 0; c < st->nslchan; c++) if(st->ChanADFreq[c] > 0) minfreq = MIN(minfreq, st->ChanADFreq[c]);
+    margin = (UINT64_T)(st->ADFrequency / minfreq) + 1;
+    wstart = (st->cursor > margin) ? st->cursor - margin : 0;
+    wstop  = (stop > margin) ? stop - margin : 0;
+    until  = stop + (UINT64_T)PLX_STREAM_SLACK * st->ADFrequency + (UINT64_T)MAX_DBH_WORDS * margin;
+    
+    idx = buildPLXIndex(&st->rd, st->offset, wstart, wstop, until,
+            st->ADFrequency, st->ChanADFreq, st->nslchan, &resume);
+    if(idx == NULL) return 5;
+    /* Nothing is read after an invalid or incomplete block: if it is the only
+     * block left, this is the last chunk. */
+    if(idx->n > 0 && resume == idx->blocks[idx->n-1].offset)
+    {
+        dbh = &idx->blocks[idx->n-1].dbh;
+        if(!validPLXBlock(dbh) || resume + sizeof(*dbh) + dbh->NumberOfWaveforms
+                * dbh->NumberOfWordsInWaveform * sizeof(short) > st->rd.filesize)
+            resume = st->rd.filesize;
+    }
+    /* Last chunk: the scan reached the end of the file, and all the blocks left
+     * of the types read by the stream end before the end of the chunk. */
+    atend = (resume >= st->rd.filesize);
+    if(!atend && idx->n > 0)
+    {
+        dbh = &idx->blocks[idx->n-1].dbh;
+        atend = (idx->blocks[idx->n-1].offset + sizeof(*dbh) + (UINT64_T)dbh->NumberOfWaveforms
+                * dbh->NumberOfWordsInWaveform * sizeof(short) >= st->rd.filesize);
+        for(k = 0; atend && k < idx->n; k++)
+        {
+            dbh = &idx->blocks[k].dbh;
+            if(idx->blocks[k].offset < resume) continue;
+            if(!validPLXBlock(dbh)) atend = false;
+            else if(dbh->Type == PL_ADDataType ? !(st->readtypes[3] || st->dense)
+                    : dbh->Type == PL_SingleWFType ? !(st->readtypes[0] || st->readtypes[1])
+                    : !st->readtypes[2]) continue;
+            else if(blockEndPLX(dbh, st->ADFrequency, st->ChanADFreq, st->nslchan) >= stop) atend = false;
+        }
+    }
+    if(groupPLXIndex(idx, st->ADFrequency, st->ChanADFreq, st->nslchan) != 0) { freePLXIndex(idx); return 5; }
+    /* Reader of this chunk: the index is not referenced by the persistent stream,
+     * in case a Matlab error interrupts the reads and frees it. */
+    rd = st->rd;
+    rd.idx = idx;
+    
+    /* Spikes, events, continuous fragments in [cursor, stop) */
+    for(i = 0; i < 5; i++) readtypes[i] = st->readtypes[i];
+    if(readtypes[0] || readtypes[1] || readtypes[2] || readtypes[3])
+        retval = readPLXData(plx, &rd, readtypes, st->numchanin, st->channels,
+                st->cursor, stop, 1, 0, switches);
+    
+    /* Flag the continuous fragments that continue the previous chunk */
+    mxptr = mxGetField(plx, 0, "ContinuousChannels");
+    if(retval == 0 && readtypes[3] && mxptr != NULL && mxGetFieldNumber(mxptr, "Timestamps") >= 0)
+    {
+        if(mxAddField(mxptr, "Continued") < 0) retval = 10;
+        for(j = 0; retval == 0 && j < mxGetNumberOfElements(mxptr); j++)
+        {
+            b = false;
+            c = (int)mxGetScalar(mxGetField(mxptr, j, "Channel"));
+            mxts = mxGetField(mxptr, j, "Timestamps");
+            mxfr = mxGetField(mxptr, j, "Fragments");
+            nf = (mxts != NULL && mxfr != NULL) ? (int)mxGetNumberOfElements(mxfr) : 0;
+            if(c >= 0 && c < st->nslchan && nf > 0)
+            {
+                if(mxIsClass(mxts, "uint64"))
+                {
+                    tsf = ((UINT64_T *)mxGetData(mxts))[0];
+                    tsl = ((UINT64_T *)mxGetData(mxts))[nf-1];
+                } else
+                {
+                    tsf = ((UINT32_T *)mxGetData(mxts))[0];
+                    tsl = ((UINT32_T *)mxGetData(mxts))[nf-1];
+                }
+                fn = ((UINT32_T *)mxGetData(mxfr))[nf-1];
+                b = ((INT64_T)tsf * st->ChanADFreq[c] == st->nextcont[c]);
+                st->nextcont[c] = (INT64_T)tsl * st->ChanADFreq[c] + fn * st->ADFrequency;
+            }
+            mxSetField(mxptr, j, "Continued", mxCreateLogicalScalar(b));
+        }
+    }
+    
+    /* Continuous channels as a dense matrix: next columns of the grid */
+    if(retval == 0 && st->dense)
+    {
+        retval = readPLXDense(plx, &rd, st->numchanin[3], st->channels[3],
+                st->t0, st->col, -1, (INT64_T)stop, st->scaled);
+        if(retval == 0) st->col += (INT64_T)mxGetN(mxGetField(plx, 0, "ContinuousData"));
+    }
+    
+    freePLXIndex(idx);
+    if(retval != 0) return retval;
+    
+    if(    mxAddField(plx, "StreamStart") < 0
+        || mxAddField(plx, "StreamStop")  < 0
+        || mxAddField(plx, "StreamEnd")   < 0) return 10;
+    mxSetField(plx, 0, "StreamStart", mxCreateDoubleScalar((double)st->cursor / st->ADFrequency));
+    mxSetField(plx, 0, "StreamStop",  mxCreateDoubleScalar((double)stop / st->ADFrequency));
+    st->offset = atend ? st->rd.filesize : resume;
+    st->cursor = stop;
+    mxSetField(plx, 0, "StreamEnd", mxCreateLogicalScalar(atend));
+    return 0;
+}
+
+/* Read the next 'duration' seconds of the stream: the file is open only during the read. */
+int readPLXStream(PLXStream *st, double duration, mxArray **out)
+{
+    int retval;
+    
+    /* File left open by a read interrupted by an error */
+    if(st->fp != NULL)
+    {
+        closePLXReader(&st->rd);
+        fclose(st->fp);
+    }
+    st->fp = fopen(st->fname, "rb");
+    if(st->fp == NULL) return 12;
+    st->rd.useindex = true;
+    openPLXReader(&st->rd, st->fp, st->fname);
+    st->rd.useindex = true;
+    if(st->rd.filesize != st->filesize || st->rd.filetime != st->filetime) retval = 12;
+    else retval = readPLXStreamChunk(st, duration, out);
+    closePLXReader(&st->rd);
+    fclose(st->fp);
+    st->fp = NULL;
+    return retval;
+}
+
+/* Report an error code returned by the reading functions. */
+void errorPLX(int retval, long offset)
+{
+    switch(retval)
+    {
+        case 0: break;
+        case 1: mexErrMsgIdAndTxt("readPLXFile:fileerror:prematureEOF",
+            "Error reading file: premature end of file (%d)",retval);
+            break;
+        case 2: mexErrMsgIdAndTxt("readPLXFile:fileerror",
+            "Error reading file (%d)",retval);
+            break;
+        case 3: mexErrMsgIdAndTxt("readPLXFile:fileerror:errorReading",
+            "Error reading file (%d)",retval);
+            break;
+        case 4: mexErrMsgIdAndTxt("readPLXFile:invalidPLXfile",
+            "Invalid PLX file (%d)",retval);
+            break;
+        case 5: mexErrMsgIdAndTxt("readPLXFile:mxMalloc",
+            "\"mxMalloc\" failed to allocate the necessary memory (%d)",retval);
+            break;
+        case 6: mexErrMsgIdAndTxt("readPLXFile:fileHeaders:channelHeader",
+            "Failed to create fields for channel headers (%d)",retval);
+            break;
+        case 7: mexErrMsgIdAndTxt("readPLXFile:fileHeaders:fullread",
+            "Failed to create field to store full read status (%d)",retval);
+            break;
+        case 8: mexErrMsgIdAndTxt("readPLXFile:fileHeaders:datastart",
+            "Failed to create field to store data start location (%d)",retval);
+            break;
+        case 9: mexErrMsgIdAndTxt("readPLXFile:fileerror:errorSeeking",
+            "Error seeking to data start location (%d)",retval);
+            break;
+        case 10: mexErrMsgIdAndTxt("readPLXFile:readData:createDataField",
+            "Failed to create field to store data (%d)",retval);
+            break;
+        case 11: mexErrMsgIdAndTxt("readPLXFile:readDense:samplingFrequency",
+            "The continuous channels must have the same sampling frequency (%d)",retval);
+            break;
+        case 12: mexErrMsgIdAndTxt("readPLXFile:stream:fileChanged",
+            "The file cannot be opened, or was modified since the stream was opened (%d)",retval);
+            break;
+        case 101: mexErrMsgIdAndTxt("readPLXFile:tally:invalidType",
+            "Invalid data block header type (%d, offset: 0x%X)",retval, offset);
+            break;
+        case 102: mexErrMsgIdAndTxt("readPLXFile:tally:invalidChannel",
+            "Invalid channel number (%d, offset: 0x%X)",retval, offset);
+            break;
+        case 103: mexErrMsgIdAndTxt("readPLXFile:tally:invalidNumWaves",
+            "Invalid number of waveforms (%d, offset: 0x%X).",retval, offset);
+            break;
+        case 104: mexErrMsgIdAndTxt("readPLXFile:tally:invalidUnit",
+            "Invalid unit number (%d, offset: 0x%X)",retval, offset);
+            break;
+        case 105: mexErrMsgIdAndTxt("readPLXFile:tally:incompleteDataBlock",
+            "Incomplete data block (%d, offset: 0x%X)",retval, offset);
+            break;
+        case 106: mexErrMsgIdAndTxt("readPLXFile:tally:mxMalloc",
+            "\"mxMalloc\" failed to allocate the necessary memory (%d)",retval);
+            break;
+        case 201: mexErrMsgIdAndTxt("readPLXFile:fileHeader:createHeaderField",
+            "Failed to create field in file header (%d)",retval);
+            break;
+        case 202: mexErrMsgIdAndTxt("readPLXFile:badPLXdate",
+            "Error converting PLX date using \"datenum\" (%d)",retval);
+            break;
+        case 203: mexErrMsgIdAndTxt("readPLXFile:spikeHeaders:createSpikeHeader",
+            "Failed to create field to store spike channel headers (%d)",retval);
+            break;
+        case 204: mexErrMsgIdAndTxt("readPLXFile:spikeHeaders:createSpikeHeaderField",
+            "Failed to create field in spike channel header (%d)",retval);
+            break;
+        case 205: mexErrMsgIdAndTxt("readPLXFile:eventHeaders:createEventHeader",
+            "Failed to create field to store event channel headers (%d)",retval);
+            break;
+        case 206: mexErrMsgIdAndTxt("readPLXFile:eventHeaders:createEventHeaderField",
+            "Failed to create field in event channel header (%d)",retval);
+            break;
+        case 207: mexErrMsgIdAndTxt("readPLXFile:continuousHeaders:createContHeader",
+            "Failed to create field to store continuous channel headers (%d)",retval);
+            break;
+        case 208: mexErrMsgIdAndTxt("readPLXFile:continuousHeaders:createContHeaderField",
+            "Failed to create field in continuous channel header (%d)",retval);
+            break;
+        case 510: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:spikeTimestamps",
+            "\"mxMalloc\" failed to allocate memory necessary for spike timestamps (%d)",retval);
+            break;
+        case 511: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:spikeUnits",
+            "\"mxMalloc\" failed to allocate memory necessary for spike units (%d)",retval);
+            break;
+        case 512: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:spikeWaves",
+            "\"mxMalloc\" failed to allocate memory necessary for spike waveforms (%d)",retval);
+            break;
+        case 520: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:eventTimestamps",
+            "\"mxMalloc\" failed to allocate memory necessary for event timestamps (%d)",retval);
+            break;
+        case 521: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:eventValues",
+            "\"mxMalloc\" failed to allocate memory necessary for event values (%d)",retval);
+            break;
+        case 530: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:continuousTimestamps",
+            "\"mxMalloc\" failed to allocate memory necessary for continuous timestamps (%d)",retval);
+            break;
+        case 531: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:continuousFragments",
+            "\"mxMalloc\" failed to allocate memory necessary for continuous fragments (%d)",retval);
+            break;
+        case 532: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:continuousValues",
+            "\"mxMalloc\" failed to allocate memory necessary for continuous values (%d)",retval);
+            break;
+        case 533: mexErrMsgIdAndTxt("readPLXFile:readDense:mxMalloc:continuousData",
+            "Failed to allocate memory necessary for continuous data matrix (%d)",retval);
+            break;
+        default: mexErrMsgIdAndTxt("readPLXFile:unrecognizedError",
+            "Unrecognized error code: %d", retval);
+    }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    bool fullread = false;
+    /* 0 = 'spikes', 1 = 'waves', 2 = 'events',
+     * 3 = 'continuous, 4 = 'units' */
+    bool readtypes[5];
+    char *fname, *arg;
+    double start = 0, stop = 0, *range, *ptr;
+    int first = 1, last = 0, num = 1, *channels[5], numchanin[5];
+    UINT64_T starttick = 0, stoptick = -1;
+    bool switches[4], haveheader = false, havenum = false;
+    bool useindex = true, indexfile = false, dense = false, scaled = false;
+    bool openstream = false;
+    /* 0 = 'havestart', 1 = 'havestop',
+     * 2 = 'havefirst', 3 = 'havelast' */
+    const char helpstr[] = "For detailed help run: readPLXFileC('help')";
+    int i, n, ADFrequency, retval = 0;
+    int lastarg = -1, revnum, h = 0;
+    long offset = 0;
+    
+    FILE* fp;
+    PLXReader rd;
+    
+    /* Check that inputs and outputs are OK */
+    if(nrhs < 1)
+        mexErrMsgIdAndTxt("readPLXFile:usage",
+            "At least one input argument is required.\n%s", helpstr);
+    else if(!mxIsChar(prhs[0]))
+        mexErrMsgIdAndTxt("readPLXFile:usage",
+            "First argument must be a filename (string), 'help', 'version', 'read', or 'close'.\n%s", helpstr);
+    
+    if(nlhs > 1)
+        mexErrMsgIdAndTxt("readPLXFile:usage",
+            "Too many output arguments.\n%s", helpstr);
     
     /* Copy the first input argument to the variable fname. */
     fname = mxArrayToString(prhs[0]);
@@ -1588,6 +2876,31 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         revnum = dispversion(nlhs == 0);
         if(nlhs > 0) plhs[0] = mxCreateDoubleScalar(revnum);
         return;
+    } else if(strcmp(fname,"read") == 0)
+    {
+        if(nrhs != 3 || !mxIsDouble(prhs[1]) || mxGetNumberOfElements(prhs[1]) != 1
+                || !mxIsDouble(prhs[2]) || mxGetNumberOfElements(prhs[2]) != 1)
+            mexErrMsgIdAndTxt("readPLXFile:usage",
+                "Usage: readPLXFileC('read', handle, duration).\n%s", helpstr);
+        h = (int)mxGetScalar(prhs[1]) - 1;
+        if(h < 0 || h >= MAX_NUM_STREAMS || streams[h] == NULL)
+            mexErrMsgIdAndTxt("readPLXFile:stream:invalidHandle",
+                "Invalid stream handle.\n%s", helpstr);
+        retval = readPLXStream(streams[h], mxGetScalar(prhs[2]), &plhs[0]);
+        errorPLX(retval, tellPLXBlock(&streams[h]->rd));
+        return;
+    } else if(strcmp(fname,"close") == 0)
+    {
+        if(nrhs < 2)
+            for(h = 0; h < MAX_NUM_STREAMS; h++) closePLXStream(h);
+        else if(mxIsDouble(prhs[1]) && mxGetNumberOfElements(prhs[1]) == 1)
+        {
+            h = (int)mxGetScalar(prhs[1]) - 1;
+            if(h >= 0 && h < MAX_NUM_STREAMS) closePLXStream(h);
+        } else
+            mexErrMsgIdAndTxt("readPLXFile:usage",
+                "Usage: readPLXFileC('close', handle).\n%s", helpstr);
+        return;
     }
     
     /* Initialize output structure. */
@@ -1630,6 +2943,29 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
             {
                 readtypes[0] = true; readtypes[1] = true;
                 readtypes[2] = true; readtypes[3] = true;
+            } else if(strcmp(arg,"dense") == 0)
+            {
+                dense = true;
+                lastarg = 3;
+            } else if(strcmp(arg,"scaled") == 0)
+            {
+                dense = true;
+                scaled = true;
+                lastarg = 3;
+            } else if(strcmp(arg,"index") == 0)
+            {
+                useindex = true;
+            } else if(strcmp(arg,"noindex") == 0)
+            {
+                useindex = false;
+                indexfile = false;
+            } else if(strcmp(arg,"indexfile") == 0)
+            {
+                useindex = true;
+                indexfile = true;
+            } else if(strcmp(arg,"open") == 0)
+            {
+                openstream = true;
             } else if(strcmp(arg,"fullread") == 0)
             {
                 fullread = true;
@@ -1776,7 +3112,16 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         mexErrMsgIdAndTxt("readPLXFile:usage",
                 "The argument '%s' must be followed by a numeric argument.\n", arg);
     
-    if(readtypes[0] || readtypes[1] || readtypes[2] || readtypes[3])
+    /* The dense matrix replaces the continuous fragments, and needs the block index. */
+    if(dense)
+    {
+        readtypes[3] = false;
+        useindex = true;
+    }
+    /* A stream only reads the headers when it is opened. */
+    if(openstream)
+        fullread = false;
+    else if(readtypes[0] || readtypes[1] || readtypes[2] || readtypes[3])
         fullread = true;
 
     /* If a header was supplied, but it wasn't a full read, but a full read
@@ -1795,125 +3140,64 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     if(fp == 0) mexErrMsgIdAndTxt("readPLXFile:fileerror",
         "Error opening file: %s\n", fname);
     
+    /* Map the file in memory, if the block index is used. */
+    rd.useindex = useindex;
+    rd.indexfile = indexfile;
+    openPLXReader(&rd, fp, fname);
+    
     /* If necessary, read the file headers. */
-    if(!haveheader) retval = scanPLXFile(plhs[0], fp, fullread);
+    if(!haveheader) retval = scanPLXFile(plhs[0], &rd, fullread);
+    
+    /* Open a stream: the data is read by the next calls. */
+    if(retval == 0 && openstream)
+    {
+        retval = resetPLXCounts(plhs[0]);
+        ADFrequency = (int)mxGetScalar(mxGetField(plhs[0], 0, "ADFrequency"));
+        starttick = switches[0] ? timeToTickPLX(start, ADFrequency) : 0;
+        closePLXReader(&rd);
+        if(retval == 0)
+        {
+            h = openPLXStream(plhs[0], fp, fname, useindex, readtypes, numchanin, channels,
+                    dense, scaled, starttick);
+        }
+        fclose(fp);
+        for(n = 0; n < 5; n++) if(channels[n] != NULL) mxFree(channels[n]);
+        errorPLX(retval, 0);
+        if(h == 0) mexErrMsgIdAndTxt("readPLXFile:stream:tooManyStreams",
+            "Too many streams open (maximum: %d)", MAX_NUM_STREAMS);
+        if(mxAddField(plhs[0], "Handle") < 0) errorPLX(10, 0);
+        mxSetField(plhs[0], 0, "Handle", mxCreateDoubleScalar(h));
+        return;
+    }
     
     /* If necessary, read the file data. */
     if(retval == 0 && (readtypes[0] || readtypes[1] || readtypes[2] || readtypes[3]))
     {
         ADFrequency = (int)mxGetScalar(mxGetField(plhs[0], 0, "ADFrequency"));
-        starttick = (int)(start*ADFrequency);
-        stoptick = (int)(stop*ADFrequency);
+        starttick = timeToTickPLX(start, ADFrequency);
+        stoptick = timeToTickPLX(stop, ADFrequency);
 
-        retval = readPLXData(plhs[0], fp, readtypes, numchanin, channels, 
+        retval = readPLXData(plhs[0], &rd, readtypes, numchanin, channels, 
                 starttick, stoptick, first, last, switches);
     }
     
+    /* If necessary, read the continuous data as a dense matrix. */
+    if(retval == 0 && dense)
+    {
+        ADFrequency = (int)mxGetScalar(mxGetField(plhs[0], 0, "ADFrequency"));
+        starttick = timeToTickPLX(start, ADFrequency);
+        stoptick = timeToTickPLX(stop, ADFrequency);
+        
+        retval = readPLXDense(plhs[0], &rd, numchanin[3], channels[3],
+                switches[0] ? (INT64_T)starttick : 0, 0, -1,
+                switches[1] ? (INT64_T)stoptick : -1, scaled);
+    }
+    
     for(n = 0; n < 5; n++) if(channels[n] != NULL) mxFree(channels[n]);
 
-    offset = ftell(fp);
+    offset = tellPLXBlock(&rd);
+    closePLXReader(&rd);
     fclose(fp);
     
-    switch(retval)
-    {
-        case 0: break;
-        case 1: mexErrMsgIdAndTxt("readPLXFile:fileerror:prematureEOF",
-            "Error reading file: premature end of file (%d)",retval);
-            break;
-        case 2: mexErrMsgIdAndTxt("readPLXFile:fileerror",
-            "Error reading file: error code %d", ferror(fp));
-            break;
-        case 3: mexErrMsgIdAndTxt("readPLXFile:fileerror:errorReading",
-            "Error reading file (%d)",retval);
-            break;
-        case 4: mexErrMsgIdAndTxt("readPLXFile:invalidPLXfile",
-            "Invalid PLX file (%d)",retval);
-            break;
-        case 5: mexErrMsgIdAndTxt("readPLXFile:mxMalloc",
-            "\"mxMalloc\" failed to allocate the necessary memory (%d)",retval);
-            break;
-        case 6: mexErrMsgIdAndTxt("readPLXFile:fileHeaders:channelHeader",
-            "Failed to create fields for channel headers (%d)",retval);
-            break;
-        case 7: mexErrMsgIdAndTxt("readPLXFile:fileHeaders:fullread",
-            "Failed to create field to store full read status (%d)",retval);
-            break;
-        case 8: mexErrMsgIdAndTxt("readPLXFile:fileHeaders:datastart",
-            "Failed to create field to store data start location (%d)",retval);
-            break;
-        case 9: mexErrMsgIdAndTxt("readPLXFile:fileerror:errorSeeking",
-            "Error seeking to data start location (%d)",retval);
-            break;
-        case 10: mexErrMsgIdAndTxt("readPLXFile:readData:createDataField",
-            "Failed to create field to store data (%d)",retval);
-            break;
-        case 101: mexErrMsgIdAndTxt("readPLXFile:tally:invalidType",
-            "Invalid data block header type (%d, offset: 0x%X)",retval, offset);
-            break;
-        case 102: mexErrMsgIdAndTxt("readPLXFile:tally:invalidChannel",
-            "Invalid channel number (%d, offset: 0x%X)",retval, offset);
-            break;
-        case 103: mexErrMsgIdAndTxt("readPLXFile:tally:invalidNumWaves",
-            "Invalid number of waveforms (%d, offset: 0x%X).",retval, offset);
-            break;
-        case 104: mexErrMsgIdAndTxt("readPLXFile:tally:invalidUnit",
-            "Invalid unit number (%d, offset: 0x%X)",retval, offset);
-            break;
-        case 105: mexErrMsgIdAndTxt("readPLXFile:tally:incompleteDataBlock",
-            "Incomplete data block (%d, offset: 0x%X)",retval, offset);
-            break;
-        case 106: mexErrMsgIdAndTxt("readPLXFile:tally:mxMalloc",
-            "\"mxMalloc\" failed to allocate the necessary memory (%d)",retval);
-            break;
-        case 201: mexErrMsgIdAndTxt("readPLXFile:fileHeader:createHeaderField",
-            "Failed to create field in file header (%d)",retval);
-            break;
-        case 202: mexErrMsgIdAndTxt("readPLXFile:badPLXdate",
-            "Error converting PLX date using \"datenum\" (%d)",retval);
-            break;
-        case 203: mexErrMsgIdAndTxt("readPLXFile:spikeHeaders:createSpikeHeader",
-            "Failed to create field to store spike channel headers (%d)",retval);
-            break;
-        case 204: mexErrMsgIdAndTxt("readPLXFile:spikeHeaders:createSpikeHeaderField",
-            "Failed to create field in spike channel header (%d)",retval);
-            break;
-        case 205: mexErrMsgIdAndTxt("readPLXFile:eventHeaders:createEventHeader",
-            "Failed to create field to store event channel headers (%d)",retval);
-            break;
-        case 206: mexErrMsgIdAndTxt("readPLXFile:eventHeaders:createEventHeaderField",
-            "Failed to create field in event channel header (%d)",retval);
-            break;
-        case 207: mexErrMsgIdAndTxt("readPLXFile:continuousHeaders:createContHeader",
-            "Failed to create field to store continuous channel headers (%d)",retval);
-            break;
-        case 208: mexErrMsgIdAndTxt("readPLXFile:continuousHeaders:createContHeaderField",
-            "Failed to create field in continuous channel header (%d)",retval);
-            break;
-        case 510: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:spikeTimestamps",
-            "\"mxMalloc\" failed to allocate memory necessary for spike timestamps (%d)",retval);
-            break;
-        case 511: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:spikeUnits",
-            "\"mxMalloc\" failed to allocate memory necessary for spike units (%d)",retval);
-            break;
-        case 512: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:spikeWaves",
-            "\"mxMalloc\" failed to allocate memory necessary for spike waveforms (%d)",retval);
-            break;
-        case 520: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:eventTimestamps",
-            "\"mxMalloc\" failed to allocate memory necessary for event timestamps (%d)",retval);
-            break;
-        case 521: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:eventValues",
-            "\"mxMalloc\" failed to allocate memory necessary for event values (%d)",retval);
-            break;
-        case 530: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:continuousTimestamps",
-            "\"mxMalloc\" failed to allocate memory necessary for continuous timestamps (%d)",retval);
-            break;
-        case 531: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:continuousFragments",
-            "\"mxMalloc\" failed to allocate memory necessary for continuous fragments (%d)",retval);
-            break;
-        case 532: mexErrMsgIdAndTxt("readPLXFile:readData:mxMalloc:continuousValues",
-            "\"mxMalloc\" failed to allocate memory necessary for continuous values (%d)",retval);
-            break;
-        default: mexErrMsgIdAndTxt("readPLXFile:unrecognizedError",
-            "Unrecognized error code: %d", retval);
-    }
+    errorPLX(retval, offset);
 }
@@ -284,17 +284,38 @@ else
     [iY,iX] = meshgrid(1:nX,1:nY);
     % Find the values above the diagonal
     indSym = find(iX <= iY);
-    % Cross-spectrum
-    Gxy = zeros(length(indSym), length(freq));
-    for i = 1:nWin
-        bst_progress('set', round(waitStart + i/nWin * 0.7 * waitMax));
-        % Get time indices for this segment
-        iTime = iWin(1,i):iWin(2,i);
-        % Frequency domain spectrum after smoothing and tapering
-        fourierX = fft(bst_bsxfun(@times, X(:,iTime), smoother'), nFFT, 2);
-        fourierY = conj(fft(bst_bsxfun(@times, Y(:,iTime), smoother'), nFFT, 2));
-        % Calculate for each frequency: fourierX * fourierY'
-        Gxy = Gxy + fourierX(iX(indSym),1:(nFFT/2)) .* fourierY(iY(indSym),1:(nFFT/2));
+    % Cross-spectrum: compiled accumulation of the upper triangle, by groups of windows
+    % (the Fourier transforms of a group take at most the size of the cross-spectrum)
+    if isequal(X,Y) && ((exist('xspectrum_mex', 'file') == 3) || bst_compile_mex('toolbox/connectivity/private/xspectrum_mex', 0, 1, '-R2018a'))
+        nWinGroup = ceil((nX+1) / 2);
+        Gxy = [];
+        for i = 1:nWinGroup:nWin
+            iGroup = i:min(i+nWinGroup-1, nWin);
+            bst_progress('set', round(waitStart + iGroup(end)/nWin * 0.7 * waitMax));
+            fourierX = complex(zeros(nX, nFFT/2, length(iGroup)));
+            for k = 1:length(iGroup)
+                % Get time indices for this segment
+                iTime = iWin(1,iGroup(k)):iWin(2,iGroup(k));
+                % Frequency domain spectrum after smoothing and tapering
+                fourierWin = fft(bst_bsxfun(@times, X(:,iTime), smoother'), nFFT, 2);
+                fourierX(:,:,k) = fourierWin(:,1:(nFFT/2));
+            end
+            % Calculate for each frequency: sum over the windows of fourierX * fourierX'
+            Gxy = xspectrum_mex(fourierX, Gxy);
+        end
+        clear fourierX fourierWin;
+    else
+        Gxy = zeros(length(indSym), length(freq));
+        for i = 1:nWin
+            bst_progress('set', round(waitStart + i/nWin * 0.7 * waitMax));
+            % Get time indices for this segment
+            iTime = iWin(1,i):iWin(2,i);
+            % Frequency domain spectrum after smoothing and tapering
+            fourierX = fft(bst_bsxfun(@times, X(:,iTime), smoother'), nFFT, 2);
+            fourierY = conj(fft(bst_bsxfun(@times, Y(:,iTime), smoother'), nFFT, 2));
+            % Calculate for each frequency: fourierX * fourierY'
+            Gxy = Gxy + fourierX(iX(indSym),1:(nFFT/2)) .* fourierY(iY(indSym),1:(nFFT/2));
+        end
     end
     % Normalize for segments and sampling rate
     Gxy = Gxy / (nWin * Fs);
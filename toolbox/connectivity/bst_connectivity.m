@@ -404,6 +404,8 @@ OPTIONS.sScoutsB = [];
 R = [];
 Time = [];
 nWinLenSamples = [];
+% Cross-spectrum accumulated as a compressed symmetric matrix [nA*(nA+1)/2 x 1 x nTime x nFreq]
+isPackedSab = 0;
 
 % Loop over input files
 for iFile = 1 : length(FilesA)
@@ -1131,10 +1133,15 @@ for iFile = 1 : length(FilesA)
                     if strcmpi(OPTIONS.TimeRes, 'none')
                         TimeRes = 0;
                     end
+                    % Symmetric NxN file: keep the cross-spectrum compressed until the file is saved (no [nA x nA x nFreq] matrix),
+                    % unless the full matrix is needed to process unconstrained sources or scouts
+                    isPackedSab = isConnNN && OPTIONS.isSymmetric && ~TimeRes && ismember(OPTIONS.Method, {'plv', 'ciplv', 'cohere'}) && ...
+                                  ~isUnconstrA && ~isUnconstrB && ...
+                                  ~((OPTIONS.isScoutA || OPTIONS.isScoutB) && strcmpi(OPTIONS.ScoutTime, 'after') && ~strcmpi(OPTIONS.ScoutFunc, 'all'));
                     if isConnNN
                         % Avoid passing redundant data
                         [S, nWinFile, OPTIONS.Freqs, Time, Messages] = bst_xspectrum(sInputA.Data, [], ...
-                            sfreq, OPTIONS.StftWinLen, OPTIONS.StftWinOvr, OPTIONS.MaxFreq, sInputB.ImagingKernel, OPTIONS.Method, TimeRes);
+                            sfreq, OPTIONS.StftWinLen, OPTIONS.StftWinOvr, OPTIONS.MaxFreq, sInputB.ImagingKernel, OPTIONS.Method, TimeRes, isPackedSab);
                     else
                         [S, nWinFile, OPTIONS.Freqs, Time, Messages] = bst_xspectrum(sInputA.Data, sInputB.Data, ...
                             sfreq, OPTIONS.StftWinLen, OPTIONS.StftWinOvr, OPTIONS.MaxFreq, sInputB.ImagingKernel, OPTIONS.Method, TimeRes);
@@ -1373,7 +1380,15 @@ function NewFile = Finalize(DataFile)
             case 'cohere'
                 % Reshape Saa as [nA, 1, nFreq] or [nA, 1, nTime, nFreq], and Sbb as [1, nB, ...] for C denominator.
                 % Still complex at this step, keep in R.Sab.
-                if isConnNN
+                if isPackedSab
+                    % Compressed symmetric Sab: row and column of each pair (upper triangle, column by column)
+                    nSig = size(R.Saa, 1);
+                    iCol = zeros(nSig*(nSig+1)/2, 1);
+                    iCol(cumsum(0:nSig-1) + 1) = 1;
+                    iCol = cumsum(iCol);
+                    iRow = (1:length(iCol))' - iCol .* (iCol-1) / 2;
+                    R.Sab = R.Sab ./ sqrt(permute(R.Saa(iRow,:,:) .* R.Saa(iCol,:,:), [1,4,2,3]));
+                elseif isConnNN
                     R.Sab = bst_bsxfun(@rdivide, R.Sab, sqrt(bst_bsxfun(@times, permute(R.Saa, [1,4,2,3]), permute(R.Saa, [4,1,2,3]))));
                 else
                     R.Sab = bst_bsxfun(@rdivide, R.Sab, sqrt(bst_bsxfun(@times, permute(R.Saa, [1,4,2,3]), permute(R.Sbb, [4,1,2,3]))));
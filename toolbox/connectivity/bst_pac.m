@@ -10,8 +10,8 @@ function [DirectPAC, LowFreqs, HighFreqs] = bst_pac(F, sRate, bandNesting, bandN
 %                      Note that cycle minimal frequency bandNesting(1) needs to be
 %                      at least 10 times smaller than signal length (duration)    
 %    - bandNested    : Candidate frequency band of nested oscillatiosn e.g., [48,300] Hz
-%    - isUseParallel : If 1, use parallel processing toolbox
-%    - isUseMex      : If 1, use mex file instead of matlab loop
+%    - isUseParallel : If 1, use parallel processing toolbox (Matlab loop only)
+%    - isUseMex      : If 1, use mex file instead of matlab loop (multithreaded if compiled with OpenMP)
 %    - numfreqs      : Number of frequency bins to use (if 0 or empty, use round(sRate/9))
 % 
 % OUTPUTS:
@@ -167,12 +167,27 @@ AMP = abs( fs(:, 1:nTime, hfreq ) );
 PHASE = exp(1i * angle( fs(:, 1:nTime, lfreq)));
 clear fs;
 
+% Compile the mex-file, or compile it again if it is the precompiled binary with the previous interface
+if isUseMex
+    [isUseMex, isLegacyMex] = bst_compile_mex('toolbox/connectivity/private/direct_pac_mex', 0, 1, '-R2018a', @CheckPacMex);
+else
+    isLegacyMex = 0;
+end
+
 % === USING MEX FILES ===
-if isUseMex && bst_compile_mex('toolbox/connectivity/private/direct_pac_mex', 0)
+if isUseMex
+    % Make sure the phase is stored as a complex array
+    if isreal(PHASE)
+        PHASE = complex(PHASE);
+    end
+    % Compute direct PAC index for all the signals and all the high-freq and low-freq pairs
+    % The mex-file reads directly the [nSignals x nTime x nFreq] arrays and is multithreaded: no permute, no parfor
+    DirectPAC = direct_pac_mex(PHASE, AMP);
+% === USING PREVIOUS MEX FILES ===
+elseif isLegacyMex
     % Initialize local DirectPAC matrix for current signals
     DirectPAC = zeros(length(lfreq), length(hfreq), nSignals);
-    % Compute direct PAC index for each high-freq and low-freq pair
-    % Permute dimensions of PHASE & AMP, easier to loop through in C
+    % The precompiled mex-file reads [nTime x nFreq x nSignals] arrays
     if isUseParallel
         parfor iSignal = 1:nSignals
             DirectPAC(:,:,iSignal) = direct_pac_mex(permute(PHASE(iSignal,:,:), [2,3,1]), permute(AMP(iSignal,:,:), [2,3,1]));
@@ -213,4 +228,12 @@ DirectPAC = reshape(DirectPAC, size(DirectPAC,1), 1, size(DirectPAC,2), size(Dir
 
 
 
+%% ===== CHECK MEX-FILE =====
+% The current mex-file returns [nSignals x nLow x nHigh], the previous one returned [nLow x nHigh x nSignals]
+function isOk = CheckPacMex()
+    DirectPAC = direct_pac_mex(complex(ones(2,3,2)), ones(2,3,2));
+    isOk = isequal(size(DirectPAC), [2 2 2]);
+
+
+
 
@@ -1,8 +1,8 @@
-function [S, nAvgLen, Freq, Time, Messages] = bst_xspectrum(A, B, Fs, WinLen, WinOverlap, MaxFreq, KernelB, Func, TimeRes)
+function [S, nAvgLen, Freq, Time, Messages] = bst_xspectrum(A, B, Fs, WinLen, WinOverlap, MaxFreq, KernelB, Func, TimeRes, isCompressSym)
 % BST_XSPECTRUM : Compute cross-spectrum or orther function of A and B Fourier transforms
 %                 used to to further compute connectivity metrics
 %
-% USAGE:  [S, nAvgLen, Freq, Time, Messages] = bst_xspectrum(A, B, Fs, WinLen, Overlap=0.5, MaxFreq=[], KernelB=[], Func='xspec', TimeRes=0)
+% USAGE:  [S, nAvgLen, Freq, Time, Messages] = bst_xspectrum(A, B, Fs, WinLen, Overlap=0.5, MaxFreq=[], KernelB=[], Func='xspec', TimeRes=0, isCompressSym=0)
 %
 % INPUTS:
 %    - A       : Signals A [nSignalsA, nTimeA]
@@ -24,6 +24,9 @@ function [S, nAvgLen, Freq, Time, Messages] = bst_xspectrum(A, B, Fs, WinLen, Wi
 %                'xspec'  : Sab (default)
 %    - TimeRes : 0 No,  average all Fourier windows, S term have the dimension [nSignalsA, nSignalsB, nFreq]
 %                1 Yes, don't average windows, S term have the dimension [nA, nB, nWin, nFreq]
+%    - isCompressSym : If 1, the all-to-all cross-spectrum Sab (A=B, TimeRes=0, Func='plv','ciplv','cohere','xspec')
+%                      is returned as a compressed symmetric matrix [nA*(nA+1)/2, 1, nFreq], in the order of
+%                      process_compress_sym (upper triangle, column by column). The full matrix is not built with xspectrum_mex.
 %
 % OUTPUTS:
 %    - S : Structure with fields listed above, possibly summed over windows (depending on nAvgLen), 
@@ -40,6 +43,9 @@ function [S, nAvgLen, Freq, Time, Messages] = bst_xspectrum(A, B, Fs, WinLen, Wi
 %   not justify the added code complexity.
 % - When not doing time-resolved, loops over windows instead of computing all at once.  Uses less
 %   memory, though somewhat slower (~25% in one test).
+% - All-to-all cross-spectrum without time resolution: accumulated over all the windows by the compiled
+%   function xspectrum_mex (upper triangle only). Unless isCompressSym=1, it is then expanded to a full
+%   [nA, nA, nFreq] matrix, which requires 16*nA^2*nFreq bytes, plus a temporary matrix of the same size.
 
 % @=============================================================================
 % This function is part of the Brainstorm software:
@@ -66,6 +72,9 @@ function [S, nAvgLen, Freq, Time, Messages] = bst_xspectrum(A, B, Fs, WinLen, Wi
 
 %% ===== INITIALIZATIONS =====
 % Default options
+if nargin < 10 || isempty(isCompressSym)
+    isCompressSym = 0;
+end
 if nargin < 9 || isempty(TimeRes)
     TimeRes = 0;
 end
@@ -175,11 +184,18 @@ if ~isNxN
 else
     nB = nA;
 end
+% All-to-all cross-spectrum: compiled accumulation of the Hermitian matrices (upper triangle only)
+isSymXspec = ~TimeRes && isNxN && ismember(Func, {'plv', 'ciplv', 'cohere', 'xspec'});
+isCompressSym = isCompressSym && isSymXspec;
+isMexXspec = isSymXspec && isa(Fa, 'double') && ...
+             ((exist('xspectrum_mex', 'file') == 3) || bst_compile_mex('toolbox/connectivity/private/xspectrum_mex', 0, 1, '-R2018a'));
 if ~TimeRes % Not time resolved: initialize for window loop
     switch Func
         case {'plv', 'ciplv', 'cohere', 'xspec'}
             % For cohere: Saa, Sbb don't need window loop thus no initialization.
-            S.Sab = complex(zeros(nA, nB, nFreq));
+            if ~isMexXspec
+                S.Sab = complex(zeros(nA, nB, nFreq));
+            end
         case 'pli'
             S.SgnImSab = zeros(nA, nB, nFreq);
         case 'wpli'
@@ -204,26 +220,37 @@ end
 %% ===== Compute requested functions for each window =====
 if ~TimeRes % Not time resolved: loop over windows
     % These terms have size [nA, nB, nFreq]
-    % This could be done faster without looping as when keeping time, but would require nWin times more memory.
-    for iWin = 1:nWin
-        % All metrics use the cross-spectrum.
-        if isNxN
-            Sab = bsxfun(@times, permute(Fa(:,:,iWin), [1,3,2]), conj(permute(Fa(:,:,iWin), [3,1,2])));
-        else
-            Sab = bsxfun(@times, permute(Fa(:,:,iWin), [1,3,2]), conj(permute(Fb(:,:,iWin), [3,1,2])));
+    % Compiled version: sum over all the windows without the [nA, nA, nFreq] product of each window
+    if isMexXspec && isCompressSym
+        S.Sab = reshape(xspectrum_mex(Fa), [], 1, nFreq);
+    elseif isMexXspec
+        S.Sab = reshape(process_compress_sym('Expand', xspectrum_mex(Fa), nA, 1), nA, nA, nFreq);
+    else
+        % This could be done faster without looping as when keeping time, but would require nWin times more memory.
+        for iWin = 1:nWin
+            % All metrics use the cross-spectrum.
+            if isNxN
+                Sab = bsxfun(@times, permute(Fa(:,:,iWin), [1,3,2]), conj(permute(Fa(:,:,iWin), [3,1,2])));
+            else
+                Sab = bsxfun(@times, permute(Fa(:,:,iWin), [1,3,2]), conj(permute(Fb(:,:,iWin), [3,1,2])));
+            end
+            switch Func
+                case 'pli'
+                    S.SgnImSab = S.SgnImSab + sign(imag(Sab));
+                case 'wpli'
+                    S.ImSab = S.ImSab + imag(Sab);
+                    S.AbsImSab = S.AbsImSab + abs(imag(Sab));
+                case 'dwpli'
+                    S.ImSab = S.ImSab + imag(Sab);
+                    S.AbsImSab = S.AbsImSab + abs(imag(Sab));
+                    S.SqImSab = S.SqImSab + imag(Sab).^2;
+                otherwise % plv, cohere, etc.
+                    S.Sab = S.Sab + Sab;
+            end
         end
-        switch Func
-            case 'pli'
-                S.SgnImSab = S.SgnImSab + sign(imag(Sab));
-            case 'wpli'
-                S.ImSab = S.ImSab + imag(Sab);
-                S.AbsImSab = S.AbsImSab + abs(imag(Sab));
-            case 'dwpli'
-                S.ImSab = S.ImSab + imag(Sab);
-                S.AbsImSab = S.AbsImSab + abs(imag(Sab));
-                S.SqImSab = S.SqImSab + imag(Sab).^2;
-            otherwise % plv, cohere, etc.
-                S.Sab = S.Sab + Sab;
+        % Compressed symmetric cross-spectrum
+        if isCompressSym
+            S.Sab = reshape(process_compress_sym('Compress', reshape(S.Sab, nA*nA, nFreq)), [], 1, nFreq);
         end
     end
     % Parts that don't need window loop, without increased memory requirement.
@@ -1,26 +1,60 @@
 /* --------------------------------------------------------------
  * file: direct_pac_mex.c - calculates directPAC metric
- *     
+ *
  * DPAC = direct_pac_mex(PHASE,AMPLITUDE)
  * INPUTS:
- * PHASE - TxMxS complex matrix (T=number of timepoints, 
- * 		M=number of low frequencies, S=number of signals)
- * AMPLITUDE - TxNxS real matrix (T=number of timepoints, 
- *              N=number of high frequencies, S=number of signals)
- * OUTPUTS:             
- * DPAC - MxNxS complex matrix (unscaled directPAC metric)
+ * PHASE - SxTxM complex matrix (S=number of signals, T=number of
+ * 		timepoints, M=number of low frequencies)
+ * AMPLITUDE - SxTxN real matrix (S=number of signals, T=number of
+ *              timepoints, N=number of high frequencies)
+ * OUTPUTS:
+ * DPAC - SxMxN complex matrix (unscaled directPAC metric)
+ *
+ * For each signal, DPAC(s,:,:) = PHASE(s,:,:).' * AMPLITUDE(s,:,:),
+ * computed as a cache-blocked complex-real matrix product:
+ *  - the signals are processed by groups of PAC_SIG_BLOCK consecutive
+ *    signals (consecutive in memory in the SxTxF layout),
+ *  - the time is processed by blocks of PAC_TIME_BLOCK samples, packed
+ *    in small contiguous buffers that stay in the L2 cache,
+ *  - the products are accumulated in 2x2 (low x high) register tiles.
+ * Each phase and amplitude value is read only once from the input arrays.
+ * The groups of signals and the high frequencies are distributed over
+ * the available cores when compiled with OpenMP.
+ *
+ * Compile with (R2018a or newer, interleaved complex API):
+ * mex -R2018a direct_pac_mex.c
+ * Multithreaded (Linux):
+ * mex -R2018a CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" direct_pac_mex.c
  * --------------------------------------------------------------*/
 
+#include <string.h>
 #include "mex.h"
 #include "math.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Number of signals packed together */
+#define PAC_SIG_BLOCK   4
+/* Number of time samples packed together */
+#define PAC_TIME_BLOCK  256
+
+/* Input/output arrays: complex values either interleaved (re,im,re,im...) or in separate arrays */
+typedef struct {
+    const double *phase_r;  /* Real part, or interleaved complex values if phase_i is NULL */
+    const double *phase_i;  /* Imaginary part (NULL if interleaved) */
+    const double *amp;
+    double *out_r;          /* Real part, or interleaved complex values if out_i is NULL */
+    double *out_i;          /* Imaginary part (NULL if interleaved) */
+    int nSig, nTime, nLow, nHigh;
+} pac_data;
+
+void computeDirectPAC(const pac_data *d, int nThreads);
 
-void computeDirectPAC(double *phase_r, double *phase_i, int *dimPhase,
-                        double *amp, const int *dimAmp,
-                        double *out_r, double *out_i);
 
 /* --------------------------------------------------------------
  * function: mexFunction - Entry point from Matlab environment
- * INPUTS: 
+ * INPUTS:
  * nlhs - number of left hand side arguments (outputs)
  * plhs[] - pointer to table where created matrix pointers are
  * to be placed
@@ -31,85 +65,218 @@ void computeDirectPAC(double *phase_r, double *phase_i, int *dimPhase,
 void mexFunction(int nlhs, mxArray *plhs[], /* Output variables */
 		int nrhs, const mxArray *prhs[]) /* Input variables */
 {
-	/* assign variables */
-	/* input & output matrices, real & imaginary part */
-	double *pA_r, *pA_i, *pB, *pOut_r, *pOut_i;
-	/* matrix dimensions */
-	int nDimA, nDimB;
-	int *dimsA, *dimsB;
-    int dimsOut[3];
+	pac_data d;
+	const mwSize *dimsA, *dimsB;
+	mwSize dimsOut[3];
+	int nThreads;
 
 	if (nrhs!=2){ mexErrMsgTxt("Expecting two inputs."); }
-	
-	/* get input dimensions */
-	nDimA = mxGetNumberOfDimensions(prhs[0]);
-	nDimB = mxGetNumberOfDimensions(prhs[1]);
-	dimsA = (int *) mxGetDimensions(prhs[0]);
-	dimsB = (int *) mxGetDimensions(prhs[1]);
-	/* add 3rd dimension if only one input signal */
-	if (nDimA==2){ *(dimsA+2)=1; *(dimsB+2)=1; }
+	if (!mxIsDouble(prhs[0]) || !mxIsComplex(prhs[0])){ mexErrMsgTxt("Input 1 has to be complex double array."); }
+	if (!mxIsDouble(prhs[1]) || mxIsComplex(prhs[1])){ mexErrMsgTxt("Input 2 has to be real double array."); }
+	if ((mxGetNumberOfDimensions(prhs[0]) > 3) || (mxGetNumberOfDimensions(prhs[1]) > 3)){ mexErrMsgTxt("Inputs must be [nSignals x nTime x nFreq] arrays."); }
+
+	/* get input dimensions: missing 3rd dimension if only one frequency */
+	dimsA = mxGetDimensions(prhs[0]);
+	dimsB = mxGetDimensions(prhs[1]);
+	d.nSig  = (int) dimsA[0];
+	d.nTime = (int) dimsA[1];
+	d.nLow  = (mxGetNumberOfDimensions(prhs[0]) == 3) ? (int) dimsA[2] : 1;
+	d.nHigh = (mxGetNumberOfDimensions(prhs[1]) == 3) ? (int) dimsB[2] : 1;
 	/* check if dimensions fit */
-    if ((*dimsA!=*dimsB) | (nDimA!=nDimB) | (*(dimsA+2)!=*(dimsB+2))){
-            mexErrMsgTxt("Input dimensions mismatch.");
-    }
-    
-	/* calculate output dimensions, allocate output, get pointer */
-    dimsOut[0] = *(dimsA+1);
-    dimsOut[1] = *(dimsB+1);
-    dimsOut[2] = *(dimsA+2); 
-	plhs[0] = mxCreateNumericArray(nDimA, dimsOut, mxDOUBLE_CLASS, 1);	
-	pOut_r = mxGetPr(plhs[0]);
-	pOut_i = mxGetPi(plhs[0]);
-	
-	/* get pointers to input matrices */	
-	if (mxIsComplex(prhs[0])){
-        	pA_r = mxGetPr(prhs[0]);
-        	pA_i = mxGetPi(prhs[0]);
-	} else mexErrMsgTxt("Input 1 has to be complex array.");
-	if (mxIsDouble(prhs[1])){
-		pB = mxGetPr(prhs[1]);
-	} else mexErrMsgTxt("Input 2 has to be double array.");		
-	
-	/* compute */
-	computeDirectPAC(pA_r, pA_i, dimsA, pB, dimsB, pOut_r, pOut_i);		
+	if ((dimsB[0] != dimsA[0]) || (dimsB[1] != dimsA[1])){
+		mexErrMsgTxt("Input dimensions mismatch.");
+	}
+
+	/* allocate output: [nSignals x nLow x nHigh] */
+	dimsOut[0] = d.nSig;
+	dimsOut[1] = d.nLow;
+	dimsOut[2] = d.nHigh;
+	plhs[0] = mxCreateNumericArray(3, dimsOut, mxDOUBLE_CLASS, mxCOMPLEX);
+
+	/* get pointers to input and output matrices */
+#if MX_HAS_INTERLEAVED_COMPLEX
+	d.phase_r = (const double*) mxGetComplexDoubles(prhs[0]);
+	d.phase_i = NULL;
+	d.out_r   = (double*) mxGetComplexDoubles(plhs[0]);
+	d.out_i   = NULL;
+#else
+	d.phase_r = mxGetPr(prhs[0]);
+	d.phase_i = mxGetPi(prhs[0]);
+	d.out_r   = mxGetPr(plhs[0]);
+	d.out_i   = mxGetPi(plhs[0]);
+#endif
+	d.amp = mxGetPr(prhs[1]);
 
+	/* compute */
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#else
+	nThreads = 1;
+#endif
+	computeDirectPAC(&d, nThreads);
 	return;
 }
 
-void computeDirectPAC(double *phase_r, double *phase_i, int *dimPhase,
-			double *amp, const int *dimAmp,
-			double *out_r, double *out_i){
-
-	int iS, iA, offA, iP, offP, iT, c; /* loop variables */
-	double tmp_r, tmp_i; /* temporary real & imaginary variables */	
-	
-	c=0; /* counter for indexing output matrix */
-	
-	/* loop over signals */
-	for (iS=0; iS<*(dimAmp+2); iS++){
-		/* high frequencies loop */
-		for (iA=0; iA<*(dimAmp+1); iA++){
-			/* offset for indexing amplitude array */
-			offA = 0 + iA * *(dimAmp) + iS * *(dimAmp) * *(dimAmp+1);
-			/* low frequencies loop */
-			for (iP=0; iP<*(dimPhase+1); iP++){
-				/* offset for indexing phase array */
-				offP = 0 + iP * *(dimPhase) + iS * *(dimPhase) * *(dimPhase+1);
-				/* time loop */
-				tmp_r = phase_r[offP] * amp[offA];
-				tmp_i = phase_i[offP] * amp[offA];
-				for (iT=1; iT<*(dimAmp); iT++){
-					tmp_r = tmp_r + phase_r[iT+offP] * amp[iT+offA];
-					tmp_i = tmp_i + phase_i[iT+offP] * amp[iT+offA];
+
+/* --------------------------------------------------------------
+ * function: pac_tile - Accumulates the products for one group of signals and one time block
+ * Packed buffers, contiguous in time:
+ *   pr[(is*nLow + iP)*nt], pi[...]  : phase, real and imaginary parts
+ *   a[(is*nHb + iA)*nt]             : amplitude
+ *   acc[((is*nHb + iA)*nLow + iP)*2]: accumulated complex products
+ * --------------------------------------------------------------*/
+static void pac_tile(const double *pr, const double *pi, const double *a, double *acc,
+                     int nSb, int nt, int nLow, int nHb){
+	int is, iA, iP, iT;
+	for (is=0; is<nSb; is++){
+		const double *prs = pr + (size_t) is * nLow * nt;
+		const double *pis = pi + (size_t) is * nLow * nt;
+		const double *as  = a  + (size_t) is * nHb  * nt;
+		double *accs = acc + (size_t) is * nHb * nLow * 2;
+		/* 2x2 register tiles: two high frequencies x two low frequencies */
+		for (iA=0; iA<nHb; iA+=2){
+			const double *a0 = as + (size_t) iA * nt;
+			const double *a1 = (iA+1 < nHb) ? a0 + nt : a0;
+			for (iP=0; iP<nLow; iP+=2){
+				const double *p0r = prs + (size_t) iP * nt, *p0i = pis + (size_t) iP * nt;
+				const double *p1r = (iP+1 < nLow) ? p0r + nt : p0r;
+				const double *p1i = (iP+1 < nLow) ? p0i + nt : p0i;
+				double r00 = 0, i00 = 0, r01 = 0, i01 = 0, r10 = 0, i10 = 0, r11 = 0, i11 = 0;
+				for (iT=0; iT<nt; iT++){
+					r00 += p0r[iT] * a0[iT];  i00 += p0i[iT] * a0[iT];
+					r01 += p1r[iT] * a0[iT];  i01 += p1i[iT] * a0[iT];
+					r10 += p0r[iT] * a1[iT];  i10 += p0i[iT] * a1[iT];
+					r11 += p1r[iT] * a1[iT];  i11 += p1i[iT] * a1[iT];
+				}
+				accs[(iA*nLow + iP)*2]     += r00;
+				accs[(iA*nLow + iP)*2 + 1] += i00;
+				if (iP+1 < nLow){
+					accs[(iA*nLow + iP+1)*2]     += r01;
+					accs[(iA*nLow + iP+1)*2 + 1] += i01;
+				}
+				if (iA+1 < nHb){
+					accs[((iA+1)*nLow + iP)*2]     += r10;
+					accs[((iA+1)*nLow + iP)*2 + 1] += i10;
+					if (iP+1 < nLow){
+						accs[((iA+1)*nLow + iP+1)*2]     += r11;
+						accs[((iA+1)*nLow + iP+1)*2 + 1] += i11;
+					}
 				}
-				out_r[c] = tmp_r;
-				out_i[c] = tmp_i;
-				c++;
 			}
 		}
 	}
-
-	return;	
 }
 
 
+/* --------------------------------------------------------------
+ * function: computeDirectPAC - Blocked computation of the unscaled directPAC
+ * The work is split in tasks (group of signals, range of high frequencies).
+ * --------------------------------------------------------------*/
+void computeDirectPAC(const pac_data *d, int nThreads){
+	const int nS = d->nSig, nT = d->nTime, nL = d->nLow, nH = d->nHigh;
+	const int nSigBlocks = (nS + PAC_SIG_BLOCK - 1) / PAC_SIG_BLOCK;
+	int nHighBlocks, hStep, nTasks;
+	double *work;
+	size_t workSize;
+
+	if ((nS == 0) || (nL == 0) || (nH == 0)){
+		return;
+	}
+	/* Split the high frequencies only if there are not enough groups of signals to keep all the threads busy */
+	nHighBlocks = 1;
+	if (nSigBlocks < nThreads){
+		nHighBlocks = (nThreads + nSigBlocks - 1) / nSigBlocks;
+		if (nHighBlocks > (nH + 1) / 2){
+			nHighBlocks = (nH + 1) / 2;
+		}
+		if (nHighBlocks < 1){
+			nHighBlocks = 1;
+		}
+	}
+	hStep  = (nH + nHighBlocks - 1) / nHighBlocks;
+	/* Keep the high frequency blocks even for the 2x2 tiles */
+	hStep += (hStep % 2);
+	nHighBlocks = (nH + hStep - 1) / hStep;
+	nTasks = nSigBlocks * nHighBlocks;
+
+	/* Work buffers for each thread: packed phase (re+im), packed amplitude, accumulators */
+	workSize = (size_t) PAC_SIG_BLOCK * (2 * nL * PAC_TIME_BLOCK + hStep * PAC_TIME_BLOCK + 2 * nL * hStep);
+	work = (double*) mxMalloc((size_t) nThreads * workSize * sizeof(double));
+
+#ifdef _OPENMP
+	#pragma omp parallel num_threads(nThreads)
+#endif
+	{
+#ifdef _OPENMP
+		double *pr = work + (size_t) omp_get_thread_num() * workSize;
+#else
+		double *pr = work;
+#endif
+		double *pi  = pr + (size_t) PAC_SIG_BLOCK * nL * PAC_TIME_BLOCK;
+		double *a   = pi + (size_t) PAC_SIG_BLOCK * nL * PAC_TIME_BLOCK;
+		double *acc = a  + (size_t) PAC_SIG_BLOCK * hStep * PAC_TIME_BLOCK;
+		int iTask;
+
+#ifdef _OPENMP
+		#pragma omp for schedule(dynamic, 1)
+#endif
+		for (iTask=0; iTask<nTasks; iTask++){
+			const int s0  = (iTask / nHighBlocks) * PAC_SIG_BLOCK;
+			const int h0  = (iTask % nHighBlocks) * hStep;
+			const int nSb = (nS - s0 < PAC_SIG_BLOCK) ? (nS - s0) : PAC_SIG_BLOCK;
+			const int nHb = (nH - h0 < hStep) ? (nH - h0) : hStep;
+			int t0, nt, is, iT, iP, iA;
+
+			memset(acc, 0, (size_t) nSb * nHb * nL * 2 * sizeof(double));
+			/* Loop on time blocks */
+			for (t0=0; t0<nT; t0+=PAC_TIME_BLOCK){
+				nt = (nT - t0 < PAC_TIME_BLOCK) ? (nT - t0) : PAC_TIME_BLOCK;
+				/* Pack phase: the signals of the group are contiguous in memory */
+				for (iP=0; iP<nL; iP++){
+					for (iT=0; iT<nt; iT++){
+						size_t iIn = s0 + (size_t) nS * ((t0 + iT) + (size_t) nT * iP);
+						for (is=0; is<nSb; is++){
+							size_t iOut = ((size_t) is * nL + iP) * nt + iT;
+							if (d->phase_i){
+								pr[iOut] = d->phase_r[iIn + is];
+								pi[iOut] = d->phase_i[iIn + is];
+							} else {
+								pr[iOut] = d->phase_r[2*(iIn + is)];
+								pi[iOut] = d->phase_r[2*(iIn + is) + 1];
+							}
+						}
+					}
+				}
+				/* Pack amplitude */
+				for (iA=0; iA<nHb; iA++){
+					for (iT=0; iT<nt; iT++){
+						size_t iIn = s0 + (size_t) nS * ((t0 + iT) + (size_t) nT * (h0 + iA));
+						for (is=0; is<nSb; is++){
+							a[((size_t) is * nHb + iA) * nt + iT] = d->amp[iIn + is];
+						}
+					}
+				}
+				/* Multiply-accumulate */
+				pac_tile(pr, pi, a, acc, nSb, nt, nL, nHb);
+			}
+			/* Copy to output matrix [nSignals x nLow x nHigh] */
+			for (is=0; is<nSb; is++){
+				for (iA=0; iA<nHb; iA++){
+					for (iP=0; iP<nL; iP++){
+						size_t iOut = (s0 + is) + (size_t) nS * (iP + (size_t) nL * (h0 + iA));
+						const double *c = acc + (((size_t) is * nHb + iA) * nL + iP) * 2;
+						if (d->out_i){
+							d->out_r[iOut] = c[0];
+							d->out_i[iOut] = c[1];
+						} else {
+							d->out_r[2*iOut]     = c[0];
+							d->out_r[2*iOut + 1] = c[1];
+						}
+					}
+				}
+			}
+		}
+	}
+	mxFree(work);
+	return;
+}
@@ -0,0 +1,273 @@
+/* --------------------------------------------------------------
+ * file: xspectrum_mex.c - accumulates the cross-spectral matrices of a set of signals
+ *
+ * S = xspectrum_mex(F, S0)
+ * INPUTS:
+ * F  - SxFxW complex matrix: Fourier transforms of the signals (S=number
+ *      of signals, F=number of frequencies, W=number of windows)
+ * S0 - PxF complex accumulator (P=S*(S+1)/2 pairs), or empty
+ * OUTPUTS:
+ * S  - PxF complex matrix: S0 + sum over the windows of F(:,f,w)*F(:,f,w)'
+ *
+ * The cross-spectral matrices are Hermitian: only the upper triangle is
+ * computed and stored, packed column by column (same order as the
+ * compressed symmetric connectivity matrices: (1,1),(1,2),(2,2),(1,3)...).
+ * The diagonal contains the auto-spectra.
+ * For each frequency, the windows are processed by blocks of XS_WIN_BLOCK:
+ *  - the Fourier coefficients of the block are packed in a contiguous
+ *    buffer (real and imaginary parts separated),
+ *  - the products are accumulated in tiles of XS_COL_BLOCK columns x
+ *    XS_ROW_BLOCK rows that stay in the L1 cache, over all the windows
+ *    of the block, before being added to the output.
+ * The frequencies are distributed over the available cores when compiled
+ * with OpenMP. Calling the function successively with the previous output
+ * as the accumulator sums the cross-spectra over groups of windows (bst_cohn).
+ *
+ * Compile with (R2018a or newer, interleaved complex API):
+ * mex -R2018a xspectrum_mex.c
+ * Multithreaded (Linux):
+ * mex -R2018a CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" xspectrum_mex.c
+ * --------------------------------------------------------------*/
+
+#include <string.h>
+#include "mex.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Number of windows packed together */
+#define XS_WIN_BLOCK  32
+/* Number of columns of the output tiles */
+#define XS_COL_BLOCK  4
+/* Number of rows of the output tiles */
+#define XS_ROW_BLOCK  256
+
+#if defined(_OPENMP) && defined(_MSC_VER)
+#define XS_OMP_FOR __pragma(omp parallel for schedule(dynamic,1))
+#elif defined(_OPENMP)
+#define XS_OMP_FOR _Pragma("omp parallel for schedule(dynamic,1)")
+#else
+#define XS_OMP_FOR
+#endif
+
+/* Input/output arrays: complex values either interleaved (re,im,re,im...) or in separate arrays */
+typedef struct {
+    const double *in_r;     /* Real part, or interleaved complex values if isInterleaved */
+    const double *in_i;     /* Imaginary part (NULL if interleaved or real input) */
+    int isInterleaved;
+    double *out_r;          /* Real part, or interleaved complex values if out_i is NULL */
+    double *out_i;          /* Imaginary part (NULL if interleaved) */
+    int nSig, nFreq, nWin;
+} xs_data;
+
+void computeXSpectrum(const xs_data *d, int nThreads);
+
+
+/* --------------------------------------------------------------
+ * function: mexFunction - Entry point from Matlab environment
+ * INPUTS:
+ * nlhs - number of left hand side arguments (outputs)
+ * plhs[] - pointer to table where created matrix pointers are
+ * to be placed
+ * nrhs - number of right hand side arguments (inputs)
+ * prhs[] - pointer to table of input matrices
+ * --------------------------------------------------------------*/
+
+void mexFunction(int nlhs, mxArray *plhs[], /* Output variables */
+        int nrhs, const mxArray *prhs[]) /* Input variables */
+{
+    xs_data d;
+    const mwSize *dims;
+    size_t nPairs, i;
+    int nThreads;
+
+    if ((nrhs < 1) || (nrhs > 2)){ mexErrMsgTxt("Expecting one or two inputs."); }
+    if (!mxIsDouble(prhs[0])){ mexErrMsgTxt("Input 1 has to be a double array."); }
+    if (mxGetNumberOfDimensions(prhs[0]) > 3){ mexErrMsgTxt("Input 1 must be a [nSignals x nFreq x nWindows] array."); }
+
+    /* get input dimensions: missing 3rd dimension if only one window */
+    dims = mxGetDimensions(prhs[0]);
+    d.nSig  = (int) dims[0];
+    d.nFreq = (int) dims[1];
+    d.nWin  = (mxGetNumberOfDimensions(prhs[0]) == 3) ? (int) dims[2] : 1;
+    nPairs  = (size_t) d.nSig * (d.nSig + 1) / 2;
+
+    /* allocate output: [nPairs x nFreq], initialized with the accumulator */
+    plhs[0] = mxCreateNumericMatrix(nPairs, d.nFreq, mxDOUBLE_CLASS, mxCOMPLEX);
+#if MX_HAS_INTERLEAVED_COMPLEX
+    d.out_r = (double*) mxGetComplexDoubles(plhs[0]);
+    d.out_i = NULL;
+#else
+    d.out_r = mxGetPr(plhs[0]);
+    d.out_i = mxGetPi(plhs[0]);
+#endif
+    if ((nrhs == 2) && !mxIsEmpty(prhs[1])){
+        if (!mxIsDouble(prhs[1]) || (mxGetM(prhs[1]) != nPairs) || (mxGetNumberOfElements(prhs[1]) != nPairs * d.nFreq)){
+            mexErrMsgTxt("Input 2 has to be a [nSignals*(nSignals+1)/2 x nFreq] double array.");
+        }
+        if (!mxIsComplex(prhs[1])){
+            const double *s0 = mxGetPr(prhs[1]);
+            for (i = 0; i < nPairs * d.nFreq; i++){
+                if (d.out_i == NULL){ d.out_r[2*i] = s0[i]; } else { d.out_r[i] = s0[i]; }
+            }
+        } else {
+#if MX_HAS_INTERLEAVED_COMPLEX
+            memcpy(d.out_r, mxGetComplexDoubles(prhs[1]), nPairs * d.nFreq * 2 * sizeof(double));
+#else
+            memcpy(d.out_r, mxGetPr(prhs[1]), nPairs * d.nFreq * sizeof(double));
+            memcpy(d.out_i, mxGetPi(prhs[1]), nPairs * d.nFreq * sizeof(double));
+#endif
+        }
+    }
+    if ((d.nSig == 0) || (d.nFreq == 0) || (d.nWin == 0)){
+        return;
+    }
+
+    /* get pointers to input matrix: real input = zero imaginary part */
+    if (!mxIsComplex(prhs[0])){
+        d.in_r = mxGetPr(prhs[0]);
+        d.in_i = NULL;
+        d.isInterleaved = 0;
+    } else {
+#if MX_HAS_INTERLEAVED_COMPLEX
+        d.in_r = (const double*) mxGetComplexDoubles(prhs[0]);
+        d.in_i = NULL;
+        d.isInterleaved = 1;
+#else
+        d.in_r = mxGetPr(prhs[0]);
+        d.in_i = mxGetPi(prhs[0]);
+        d.isInterleaved = 0;
+#endif
+    }
+
+    /* compute */
+#ifdef _OPENMP
+    nThreads = omp_get_max_threads();
+#else
+    nThreads = 1;
+#endif
+    computeXSpectrum(&d, nThreads);
+    return;
+}
+
+
+/* --------------------------------------------------------------
+ * function: xs_pack - Copies the coefficients of one frequency and one block of windows
+ * Packed buffers, contiguous in signals: ar[iw*nSig + is], ai[...]
+ * --------------------------------------------------------------*/
+static void xs_pack(const xs_data *d, int iFreq, int w0, int nw, double *ar, double *ai)
+{
+    int iw, is;
+    size_t off;
+    for (iw = 0; iw < nw; iw++){
+        off = ((size_t) (w0 + iw) * d->nFreq + iFreq) * d->nSig;
+        if (d->isInterleaved){
+            const double *z = d->in_r + 2 * off;
+            for (is = 0; is < d->nSig; is++){
+                ar[(size_t) iw * d->nSig + is] = z[2*is];
+                ai[(size_t) iw * d->nSig + is] = z[2*is+1];
+            }
+        } else {
+            memcpy(ar + (size_t) iw * d->nSig, d->in_r + off, d->nSig * sizeof(double));
+            if (d->in_i != NULL){
+                memcpy(ai + (size_t) iw * d->nSig, d->in_i + off, d->nSig * sizeof(double));
+            } else {
+                memset(ai + (size_t) iw * d->nSig, 0, d->nSig * sizeof(double));
+            }
+        }
+    }
+}
+
+
+/* --------------------------------------------------------------
+ * function: xs_tile - Accumulates the products for one tile and one block of windows
+ * Rows [i0, i0+ni), columns [j0, j0+nj): S(i,j) += sum_w a(i,w) * conj(a(j,w))
+ * The tile is added to the packed output, only for the rows i <= j.
+ * --------------------------------------------------------------*/
+static void xs_tile(const xs_data *d, int iFreq, const double *ar, const double *ai, int nw,
+                    int i0, int ni, int j0, int nj, double *tr, double *ti)
+{
+    double br[XS_COL_BLOCK], bi[XS_COL_BLOCK], xr, xi;
+    const double *pr, *pi;
+    size_t p, off;
+    int iw, i, jj, j, iMax;
+
+    memset(tr, 0, XS_COL_BLOCK * XS_ROW_BLOCK * sizeof(double));
+    memset(ti, 0, XS_COL_BLOCK * XS_ROW_BLOCK * sizeof(double));
+    for (iw = 0; iw < nw; iw++){
+        pr = ar + (size_t) iw * d->nSig;
+        pi = ai + (size_t) iw * d->nSig;
+        /* Conjugate of the column coefficients */
+        for (jj = 0; jj < nj; jj++){
+            br[jj] =  pr[j0 + jj];
+            bi[jj] = -pi[j0 + jj];
+        }
+        for (jj = 0; jj < nj; jj++){
+            double *tjr = tr + jj * XS_ROW_BLOCK;
+            double *tji = ti + jj * XS_ROW_BLOCK;
+            for (i = 0; i < ni; i++){
+                xr = pr[i0 + i];
+                xi = pi[i0 + i];
+                tjr[i] += xr * br[jj] - xi * bi[jj];
+                tji[i] += xr * bi[jj] + xi * br[jj];
+            }
+        }
+    }
+    /* Add to the output: column j starts at j*(j+1)/2 */
+    off = (size_t) iFreq * ((size_t) d->nSig * (d->nSig + 1) / 2);
+    for (jj = 0; jj < nj; jj++){
+        j = j0 + jj;
+        iMax = (j - i0 + 1 < ni) ? (j - i0 + 1) : ni;
+        p = off + (size_t) j * (j + 1) / 2 + i0;
+        if (d->out_i == NULL){
+            for (i = 0; i < iMax; i++){
+                d->out_r[2*(p+i)]   += tr[jj * XS_ROW_BLOCK + i];
+                d->out_r[2*(p+i)+1] += ti[jj * XS_ROW_BLOCK + i];
+            }
+        } else {
+            for (i = 0; i < iMax; i++){
+                d->out_r[p+i] += tr[jj * XS_ROW_BLOCK + i];
+                d->out_i[p+i] += ti[jj * XS_ROW_BLOCK + i];
+            }
+        }
+    }
+}
+
+
+/* --------------------------------------------------------------
+ * function: computeXSpectrum - Loops over the frequencies, blocks of windows and tiles
+ * The work buffers are allocated before the parallel region (mxMalloc is not thread-safe)
+ * --------------------------------------------------------------*/
+void computeXSpectrum(const xs_data *d, int nThreads)
+{
+    size_t nBuf = (size_t) 2 * XS_WIN_BLOCK * d->nSig + 2 * XS_COL_BLOCK * XS_ROW_BLOCK;
+    double *work = (double*) mxMalloc(nThreads * nBuf * sizeof(double));
+    int iFreq;
+
+    XS_OMP_FOR
+    for (iFreq = 0; iFreq < d->nFreq; iFreq++){
+#ifdef _OPENMP
+        double *buf = work + (size_t) omp_get_thread_num() * nBuf;
+#else
+        double *buf = work;
+#endif
+        double *ar = buf;
+        double *ai = buf + (size_t) XS_WIN_BLOCK * d->nSig;
+        double *tr = buf + (size_t) 2 * XS_WIN_BLOCK * d->nSig;
+        double *ti = tr + XS_COL_BLOCK * XS_ROW_BLOCK;
+        int w0, nw, i0, ni, j0, nj;
+        for (w0 = 0; w0 < d->nWin; w0 += XS_WIN_BLOCK){
+            nw = (d->nWin - w0 < XS_WIN_BLOCK) ? (d->nWin - w0) : XS_WIN_BLOCK;
+            xs_pack(d, iFreq, w0, nw, ar, ai);
+            for (j0 = 0; j0 < d->nSig; j0 += XS_COL_BLOCK){
+                nj = (d->nSig - j0 < XS_COL_BLOCK) ? (d->nSig - j0) : XS_COL_BLOCK;
+                /* Rows of the upper triangle: i <= j0+nj-1 */
+                for (i0 = 0; i0 < j0 + nj; i0 += XS_ROW_BLOCK){
+                    ni = (j0 + nj - i0 < XS_ROW_BLOCK) ? (j0 + nj - i0) : XS_ROW_BLOCK;
+                    xs_tile(d, iFreq, ar, ai, nw, i0, ni, j0, nj, tr, ti);
+                }
+            }
+        }
+    }
+    mxFree(work);
+}
@@ -1,5 +1,22 @@
-function isOk = bst_compile_mex(fcn_name, isInteractive)
+function [isOk, isOutdated] = bst_compile_mex(fcn_name, isInteractive, isOpenMP, apiFlag, CheckFcn)
 % BST_COMPILE_MEX: Compiles a MEX-file before using it.
+%
+% USAGE:  [isOk, isOutdated] = bst_compile_mex(fcn_name, isInteractive=1, isOpenMP=0, apiFlag='', CheckFcn=[])
+%
+% INPUTS:
+%    - fcn_name      : Path to the C file, relative to the Brainstorm folder, without extension
+%    - isInteractive : If 1, display the errors in a dialog window
+%    - isOpenMP      : If 1, try first to compile with the OpenMP flags (multithreaded MEX),
+%                      and compile without them if it fails (eg. Apple clang)
+%    - apiFlag       : MEX API flag used with Matlab >= 2018a (eg. '-R2018a' for the interleaved complex API),
+%                      ignored with older versions: the C file must support both APIs
+%    - CheckFcn      : Handle to a function returning 1 if the existing mex-file is up to date (called once per session)
+%                      If it returns 0 or fails, the mex-file is compiled again in a temporary folder,
+%                      and the outdated file is replaced only if the compilation succeeds
+%
+% OUTPUTS:
+%    - isOk       : 1 if an up-to-date mex-file is available
+%    - isOutdated : 1 if only an outdated mex-file is available (it could not be compiled again)
 
 % @=============================================================================
 % This function is part of the Brainstorm software:
@@ -21,7 +38,18 @@ function isOk = bst_compile_mex(fcn_name, isInteractive)
 %
 % Authors: Francois Tadel, 2011-2013
 
+% Mex-files already checked in this session
+persistent CheckedMex;
 % Parse inputs
+if (nargin < 5) || isempty(CheckFcn)
+    CheckFcn = [];
+end
+if (nargin < 4) || isempty(apiFlag) || (bst_get('MatlabVersion') < 904)
+    apiFlag = '';
+end
+if (nargin < 3) || isempty(isOpenMP)
+    isOpenMP = 0;
+end
 if (nargin < 2) || isempty(isInteractive)
     isInteractive = 1;
 end
@@ -31,6 +59,7 @@ userMexDir        = bst_get('UserMexDir');
 % Remember current directory
 previousDir = pwd;
 isOk = 0;
+isOutdated = 0;
 
 % Got to mex file directory
 cFile   = bst_fullfile(BrainstormHomeDir, [fcn_name '.c']);
@@ -48,6 +77,46 @@ if file_exist(mexFile)
     end
 end
 
+% Check if the existing mex-file is up to date (once per session)
+if ~isempty(CheckFcn) && (file_exist(mexFile) || file_exist(mexFileUser))
+    % Already checked in this session
+    if isstruct(CheckedMex) && isfield(CheckedMex, mexName)
+        isOutdated = CheckedMex.(mexName);
+    else
+        try
+            isOutdated = ~CheckFcn();
+        catch
+            isOutdated = 1;
+        end
+        % Outdated file: compile it again in the temporary folder, and replace it only if it works
+        if isOutdated
+            if file_exist(mexFile)
+                oldFile = mexFile;
+            else
+                oldFile = mexFileUser;
+            end
+            % Unload the outdated mex-file before replacing it
+            clear(mexName);
+            if file_attrib(oldFile, 'w')
+                disp(['BST> MEX file "' fcn_name '" is outdated.']);
+                tmpDir = bst_get('BrainstormTmpDir');
+                if CompileMex(cFile, tmpDir, fcn_name, isInteractive, isOpenMP, apiFlag)
+                    isOutdated = ~file_move(bst_fullfile(tmpDir, [mexName '.' mexext]), oldFile);
+                end
+            else
+                disp(['BST> MEX file "' fcn_name '" is outdated, and you are not allowed to replace it.']);
+            end
+        end
+        CheckedMex.(mexName) = isOutdated;
+    end
+    cd(previousDir);
+    isOk = ~isOutdated;
+    if isOk
+        rehash path;
+    end
+    return;
+end
+
 % Check if mex-file is not accessible: need to compile file
 if ~file_exist(mexFile) && ~file_exist(mexFileUser)
     % === CHECK FILE RIGHTS ===
@@ -81,23 +150,9 @@ if ~file_exist(mexFile) && ~file_exist(mexFileUser)
     end
 
     % === COMPILE MEX ===
-    try
-        fprintf(1, ['BST> Compiling: ', mexName, '... ']);
-        mex('-v', cFile);
-        fprintf(1, 'ok\n');
-    catch
-        % === PROCESS ERROR ===
-        fprintf(1, 'failed\n');
-        errMsg = ['Cannot compile MEX file "' fcn_name '": MEX compiler error.' 10 lasterr];
-        if isInteractive
-            bst_error(errMsg, 'MEX compilation error', 0);
-            bst_help('MexError.html', 0);
-        else
-            disp([10 errMsg]);
-        end
+    if ~CompileMex(cFile, pwd, fcn_name, isInteractive, isOpenMP, apiFlag)
         cd(previousDir);
         return
-
     end
 end
 
@@ -110,3 +165,48 @@ rehash path;
 
 
 
+%% ===== COMPILE MEX-FILE =====
+% Compile the C file cFile, and save the mex-file in folder outDir
+function isOk = CompileMex(cFile, outDir, fcn_name, isInteractive, isOpenMP, apiFlag)
+    [tmp, mexName] = fileparts(cFile);
+    try
+        fprintf(1, ['BST> Compiling: ', mexName, '... ']);
+        % OpenMP flags for the current compiler
+        ompFlags = {};
+        if isOpenMP
+            if ispc
+                ompFlags = {'COMPFLAGS=$COMPFLAGS /openmp'};
+            elseif ~ismac
+                ompFlags = {'CFLAGS=$CFLAGS -fopenmp', 'LDFLAGS=$LDFLAGS -fopenmp'};
+            end
+        end
+        % MEX API requested by the caller
+        if ~isempty(apiFlag)
+            apiFlags = {apiFlag};
+        else
+            apiFlags = {};
+        end
+        % Compile with OpenMP, and without if it is not supported
+        if ~isempty(ompFlags)
+            try
+                mex('-v', apiFlags{:}, ompFlags{:}, '-outdir', outDir, cFile);
+            catch
+                mex('-v', apiFlags{:}, '-outdir', outDir, cFile);
+            end
+        else
+            mex('-v', apiFlags{:}, '-outdir', outDir, cFile);
+        end
+        fprintf(1, 'ok\n');
+        isOk = 1;
+    catch
+        % === PROCESS ERROR ===
+        fprintf(1, 'failed\n');
+        errMsg = ['Cannot compile MEX file "' fcn_name '": MEX compiler error.' 10 lasterr];
+        if isInteractive
+            bst_error(errMsg, 'MEX compilation error', 0);
+            bst_help('MexError.html', 0);
+        else
+            disp([10 errMsg]);
+        end
+        isOk = 0;
+    end
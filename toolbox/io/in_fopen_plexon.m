@@ -122,9 +122,10 @@ end
 Fs = adfreq;
 
 % Extract information needed for opening the file
-hdr.FirstTimeStamp    = ts;
-hdr.LastTimeStamp     = fn/Fs+ts;
-hdr.NumSamples        = fn;
+% Time grid from the first to the last fragment of recording (the gaps are filled with zeros by in_fread_plexon)
+hdr.FirstTimeStamp    = ts(1);
+hdr.NumSamples        = round((ts(end) - ts(1)) * Fs) + fn(end);
+hdr.LastTimeStamp     = hdr.NumSamples/Fs + ts(1);
 hdr.SamplingFrequency = Fs;
 
 % Assign important fields
@@ -144,7 +145,7 @@ sFile.header    = hdr;
 sFile.comment   = Comment;
 sFile.prop.nAvg  = 1;
 sFile.prop.sfreq = Fs;
-sFile.prop.times = [ts, (fn - 1)/Fs+ts];
+sFile.prop.times = [ts(1), (hdr.NumSamples - 1)/Fs + ts(1)];
 
 % No info on bad channels
 sFile.channelflag = ones(hdr.ChannelCount, 1);
@@ -24,11 +24,8 @@ function F = in_fread_plexon(sFile, SamplesBounds, iChannels, precision)
 % Authors: Konstantinos Nasiotis, 2018-2022
 %          Martin Cousineau, 2019
 
-% ===== INSTALL PLEXON SDK =====
-[isInstalled, errMsg] = bst_plugin('Install', 'plexon');
-if ~isInstalled
-    error(errMsg);
-end
+% Stream on the file read by the previous call (the file is only open during the reads), raw channel numbers of the last file
+persistent sPlxStream sPlxChannels isMexPlx
 
 % ===== PARSE INPUTS =====
 if (nargin < 4) || isempty(precision)
@@ -53,12 +50,122 @@ iSelectedChannels = sFile.header.chan_headers;
 nChannels = length(iSelectedChannels);
 nSamples  = diff(SamplesBounds) + 1;
 
+% ===== PLX: COMPILED READER =====
+% Reads all the channels in one pass, directly as a [nChannels x nSamples] matrix in Volts
+% Compiled once per session: the precompiled binary (no streams, no option 'scaled') is compiled again,
+% or replaced with the Plexon SDK if it cannot be compiled
+plx = [];
+if isempty(isMexPlx) && strcmpi(sFile.header.extension, '.plx')
+    isMexPlx = bst_compile_mex('external/plexon/readPLXFileC', 0, 1, '', @CheckPlxMex);
+end
+if strcmpi(sFile.header.extension, '.plx') && isMexPlx
+    Fs = sFile.prop.sfreq;
+    % Sample #i is at time FirstTimeStamp + (i-1)/Fs
+    tStart = sFile.header.FirstTimeStamp + (SamplesBounds(1) - 1) / Fs;
+    tStop  = sFile.header.FirstTimeStamp + SamplesBounds(2) / Fs;
+    % Consecutive blocks read from the beginning of the file (processing of the file by blocks):
+    % read from a stream, without indexing the entire file
+    isNext = ~isempty(sPlxStream) && strcmp(sPlxStream.filename, sFile.filename) && ...
+             isequal(sPlxStream.iChannels, iSelectedChannels) && (sPlxStream.nextSample == SamplesBounds(1));
+    % Raw numbers of the selected channels: chan_headers are indices in the list of A/D channels of the file
+    if isempty(sPlxChannels) || ~strcmp(sPlxChannels.filename, sFile.filename)
+        plxHeader = readPLXFileC(sFile.filename, 'headers');
+        sPlxChannels = struct('filename', sFile.filename, ...
+                              'Channels', [plxHeader.ContinuousChannels.Channel]);
+    end
+    plxChannels = sPlxChannels.Channels(iSelectedChannels);
+    % Close the previous stream
+    if ~isNext && ~isempty(sPlxStream)
+        readPLXFileC('close', sPlxStream.Handle);
+        sPlxStream = [];
+    end
+    if ~isNext && (SamplesBounds(1) == 1)
+        hdr = readPLXFileC(sFile.filename, 'open', 'scaled', plxChannels, 'start', tStart);
+        sPlxStream = struct('filename',   sFile.filename, ...
+                            'iChannels',  iSelectedChannels, ...
+                            'Handle',     hdr.Handle, ...
+                            'nextSample', SamplesBounds(1));
+        isNext = true;
+    end
+    if isNext
+        try
+            plx = readPLXFileC('read', sPlxStream.Handle, nSamples / Fs);
+        catch ME
+            % Stream closed by "clear mex": read the block with the index
+            if ~strcmp(ME.identifier, 'readPLXFile:stream:invalidHandle')
+                rethrow(ME);
+            end
+            plx = [];
+        end
+        % The stream can only be continued if the block has exactly the requested size
+        % It is closed after the last block of the recording
+        if isfield(plx, 'ContinuousData') && (size(plx.ContinuousData,2) == nSamples) && ~plx.StreamEnd && (SamplesBounds(2) < sFile.header.NumSamples)
+            sPlxStream.nextSample = SamplesBounds(2) + 1;
+        else
+            readPLXFileC('close', sPlxStream.Handle);
+            sPlxStream = [];
+            if ~isfield(plx, 'ContinuousData') || (size(plx.ContinuousData,2) ~= nSamples)
+                plx = [];
+            end
+        end
+    end
+    % Random access: read the time window using the block index
+    if isempty(plx)
+        plx = readPLXFileC(sFile.filename, 'scaled', plxChannels, 'start', tStart, 'stop', tStop);
+    end
+end
+if isfield(plx, 'ContinuousData')
+    F = plx.ContinuousData;
+    % Rounding of the time window
+    if (size(F,2) > nSamples)
+        F = F(:, 1:nSamples);
+    elseif (size(F,2) < nSamples)
+        F(:, end+1:nSamples) = 0;
+    end
+    if strcmpi(precision, 'double')
+        F = double(F);
+    end
+    return;
+end
+
+% ===== INSTALL PLEXON SDK =====
+[isInstalled, errMsg] = bst_plugin('Install', 'plexon');
+if ~isInstalled
+    error(errMsg);
+end
+
 % Initialize Brainstorm output
 F = zeros(nChannels, nSamples, precision);
 
-for iChannel = 1:nChannels 
-    % plx_ad_span_v returns values in mV
-    [adfreq, n, data] = plx_ad_span_v(sFile.filename, iSelectedChannels(iChannel)-1, SamplesBounds(1), SamplesBounds(2));    
-    F(iChannel,:) = data./1000; % Convert to V
+% Recording gaps are filled with zeros, as in the compiled reader:
+% each fragment of recording is placed on the time grid of the file, at its timestamp
+for iChannel = 1:nChannels
+    iChan = iSelectedChannels(iChannel) - 1;
+    % Timestamps and number of samples of the fragments
+    [adfreq, n, tsFrag, fnFrag] = plx_ad_gap_info(sFile.filename, iChan);
+    fnFrag = fnFrag(:);
+    % First sample of each fragment: in the file, and on the time grid
+    iFileFrag = [1; cumsum(fnFrag(1:end-1)) + 1];
+    iGridFrag = round((tsFrag(:) - sFile.header.FirstTimeStamp) .* sFile.prop.sfreq) + 1;
+    for iFrag = 1:length(fnFrag)
+        % Samples of the fragment in the requested time window
+        iStart = max(SamplesBounds(1), iGridFrag(iFrag));
+        iStop  = min(SamplesBounds(2), iGridFrag(iFrag) + fnFrag(iFrag) - 1);
+        if (iStop < iStart)
+            continue;
+        end
+        % plx_ad_span_v returns values in mV
+        iFile = iFileFrag(iFrag) - iGridFrag(iFrag) + [iStart, iStop];
+        [adfreq, n, data] = plx_ad_span_v(sFile.filename, iChan, iFile(1), iFile(2));
+        F(iChannel, (iStart:iStop) - SamplesBounds(1) + 1) = data ./ 1000; % Convert to V
+    end
+end
+end
+
+
+%% ===== CHECK MEX-FILE =====
+% The precompiled binary does not support the streams: readPLXFileC('close') fails
+function isOk = CheckPlxMex()
+    readPLXFileC('close');
+    isOk = 1;
 end
-end
\ No newline at end of file
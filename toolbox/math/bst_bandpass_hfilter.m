@@ -20,6 +20,7 @@ function [x, FiltSpec, Messages] = bst_bandpass_hfilter(x, Fs, HighPass, LowPass
 %    - isMirror   : isMirror (default = 0 no mirroring)
 %    - isRelax    : Change ripple and attenuation coefficients (default=0 no relaxation)
 %    - Function   : 'fftfilt', filtering in frequency domain (default)
+%                   (compiled overlap-save function bst_fftfilt.c, or fftfilt if it cannot be compiled)
 %                 'filter', filtering in time domain
 %                   If not specified, detects automatically the fastest option based on the filter order
 %    - TranBand   : Width of the transition band in Hz
@@ -242,28 +243,43 @@ if (FiltSpec.mirror) && (nTime < M)
     Messages = [Messages, 'Warning: Data is too short for mirroring. Option is ignored...' 10];
     FiltSpec.mirror = 0;
 end
-% Mirror signals
-if (FiltSpec.mirror)
-    x = [fliplr(x(:,1:M)), x, fliplr(x(:,end-M+1:end))];
-    % Zero-padding
-else
-    x = [zeros(nChan,M), x, zeros(nChan,M)] ;
-end
 
-% Filter signals
-switch (FiltSpec.function)
-    case 'fftfilt'
-        if bst_get('UseSigProcToolbox')
-            x = fftfilt(FiltSpec.b, x')';
-        else
-            x = oc_fftfilt(FiltSpec.b, x')';
-        end
-    case 'filter'
-        x = filter(FiltSpec.b, FiltSpec.a, x, [], 2);
+% Compiled overlap-save filter: compensates the delay itself, no zero-padded or transposed copies of the signals
+isMexFilt = strcmpi(FiltSpec.function, 'fftfilt');
+if isMexFilt && (exist('bst_fftfilt', 'file') ~= 3)
+    isMexFilt = bst_compile_mex('toolbox/math/bst_fftfilt', 0, 1);
 end
+if isMexFilt
+    if (FiltSpec.mirror)
+        x = bst_fftfilt([fliplr(x(:,1:M)), x, fliplr(x(:,end-M+1:end))], FiltSpec.b);
+        x = x(:,M+1:end-M);
+    else
+        x = bst_fftfilt(x, FiltSpec.b);
+    end
+else
+    % Mirror signals
+    if (FiltSpec.mirror)
+        x = [fliplr(x(:,1:M)), x, fliplr(x(:,end-M+1:end))];
+        % Zero-padding
+    else
+        x = [zeros(nChan,M), x, zeros(nChan,M)] ;
+    end
 
-% Remove extra data
-x = x(:,2*M+1:end);
+    % Filter signals
+    switch (FiltSpec.function)
+        case 'fftfilt'
+            if bst_get('UseSigProcToolbox')
+                x = fftfilt(FiltSpec.b, x')';
+            else
+                x = oc_fftfilt(FiltSpec.b, x')';
+            end
+        case 'filter'
+            x = filter(FiltSpec.b, FiltSpec.a, x, [], 2);
+    end
+
+    % Remove extra data
+    x = x(:,2*M+1:end);
+end
 % Restore the mean of the signal (only if there is no high-pass filter)
 if (FiltSpec.f_highpass == 0)
     x = bst_bsxfun(@plus, x, xmean);
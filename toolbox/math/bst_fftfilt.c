@@ -0,0 +1,444 @@
+/*--------------------------------------------------------------
+ * file: bst_fftfilt.c - FIR filtering by overlap-save, with compensation of the filter delay
+ *                       Chunked processing: the state of the filter can be carried from one call to the next
+ *
+ * [y, zf] = bst_fftfilt(x, b, zi, isLast)
+ *
+ * INPUTS:
+ *    - x      : [nChannels x nTime] double or single matrix, filtered along the rows
+ *    - b      : FIR filter coefficients (vector of length nb)
+ *    - zi     : State of the filter returned by the previous call, or [] at the beginning of the signal
+ *    - isLast : If 1, x is the last chunk of the signal (default: 1)
+ * OUTPUTS:
+ *    - y  : Filtered signals, same class as x, delayed by -D = -floor((nb-1)/2) samples
+ *           For one call: y = filter(b, 1, [x, zeros(nChannels,D)], [], 2), without the first D samples
+ *           When the signal is processed by chunks, y only contains the samples of the complete blocks,
+ *           the following ones are returned by the next calls.
+ *    - zf : State of the filter (structure), to pass to the next call ([] if isLast=1)
+ *
+ * The signals are filtered by blocks of L = nfft-nb+1 samples: the FFT of [nb-1 previous samples, L new
+ * samples] is multiplied with the FFT of the filter, the last L samples of the inverse FFT are the outputs.
+ * The blocks are aligned on the beginning of the signal, and nfft only depends on the filter length:
+ * processing a file by chunks gives exactly the same values as filtering the entire file at once.
+ * The FFT plans (twiddle factors and FFT of the filter) are kept in memory for the next calls.
+ * The channels are distributed over the available cores when compiled with OpenMP. The computation
+ * is done in double precision, the output has the class of the input (no copy of the signals as double).
+ *-------------------------------------------------------------- */
+#include <math.h>
+#include <string.h>
+#include "mex.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Compile with:
+ * mex -v bst_fftfilt.c
+ * or with OpenMP (Linux):
+ * mex -v CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" bst_fftfilt.c */
+
+/* Number of FFT plans kept in memory */
+#define FF_NPLANS 8
+/* Number of channels gathered together (consecutive in memory in the input matrix) */
+#define FF_GROUP 8
+/* Maximum FFT length */
+#define FF_MAXFFT (1 << 22)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(_OPENMP) && defined(_MSC_VER)
+#define FF_OMP_FOR __pragma(omp parallel for schedule(dynamic,1))
+#elif defined(_OPENMP)
+#define FF_OMP_FOR _Pragma("omp parallel for schedule(dynamic,1)")
+#else
+#define FF_OMP_FOR
+#endif
+
+/* FFT plan: real FFT of length nfft, computed as a complex FFT of length nfft/2 */
+typedef struct {
+    int nfft;       /* FFT length (power of 2) */
+    int nb;         /* Filter length */
+    double *b;      /* Filter coefficients (key of the cache) */
+    double *tw;     /* Twiddle factors of the complex FFT: exp(-2i*pi*k/(nfft/2)), k < nfft/4 */
+    double *ws;     /* Twiddle factors of the real split: exp(-2i*pi*k/nfft), k <= nfft/2 */
+    int *rev;       /* Bit-reversal permutation of the complex FFT */
+    double *H;      /* FFT of the filter, scaled for the inverse FFT (nfft/2+1 complex values) */
+} fft_plan;
+
+static fft_plan plans[FF_NPLANS];
+static int nextPlan = 0;
+
+
+/*--------------------------------------------------------------
+ * function: free_plans - Release the cached FFT plans (when the mex-file is cleared)
+ *-------------------------------------------------------------- */
+static void free_plans(void){
+    int i;
+    for (i=0; i<FF_NPLANS; i++){
+        if (plans[i].nfft == 0) continue;
+        mxFree(plans[i].b);
+        mxFree(plans[i].tw);
+        mxFree(plans[i].ws);
+        mxFree(plans[i].rev);
+        mxFree(plans[i].H);
+        plans[i].nfft = 0;
+    }
+}
+
+
+/*--------------------------------------------------------------
+ * function: cfft - In-place radix-2 complex FFT (interleaved real/imaginary), unscaled
+ *-------------------------------------------------------------- */
+static void cfft(double *z, int n, const double *tw, const int *rev, int isInverse){
+    int i, j, k, len, half, step;
+    double tr, ti, wr, wi, ur, ui;
+    /* Bit-reversal permutation */
+    for (i=0; i<n; i++){
+        j = rev[i];
+        if (i < j){
+            tr = z[2*i]; z[2*i] = z[2*j]; z[2*j] = tr;
+            ti = z[2*i+1]; z[2*i+1] = z[2*j+1]; z[2*j+1] = ti;
+        }
+    }
+    /* Butterflies */
+    for (len=2; len<=n; len<<=1){
+        half = len >> 1;
+        step = n / len;
+        for (i=0; i<n; i+=len){
+            for (k=0; k<half; k++){
+                wr = tw[2*k*step];
+                wi = isInverse ? -tw[2*k*step+1] : tw[2*k*step+1];
+                j  = i + k;
+                ur = z[2*(j+half)];
+                ui = z[2*(j+half)+1];
+                tr = ur * wr - ui * wi;
+                ti = ur * wi + ui * wr;
+                z[2*(j+half)]   = z[2*j]   - tr;
+                z[2*(j+half)+1] = z[2*j+1] - ti;
+                z[2*j]   += tr;
+                z[2*j+1] += ti;
+            }
+        }
+    }
+}
+
+
+/*--------------------------------------------------------------
+ * function: rfft - Real FFT of x[nfft] (in place): returns X[0..nfft/2] in z (nfft/2+1 complex values)
+ *                  z must have nfft+2 values
+ *-------------------------------------------------------------- */
+static void rfft(double *z, const fft_plan *p){
+    int m = p->nfft / 2, k;
+    double zr, zi, cr, ci, er, ei, or_, oi, wr, wi;
+    /* Complex FFT of the even/odd samples packed as z[n] = x[2n] + i*x[2n+1] */
+    cfft(z, m, p->tw, p->rev, 0);
+    z[2*m]   = z[0];
+    z[2*m+1] = z[1];
+    /* Split: X[k] = E[k] + W^k O[k], computed for the pairs (k, m-k) */
+    for (k=0; k<=m/2; k++){
+        zr = z[2*k];       zi = z[2*k+1];
+        cr = z[2*(m-k)];   ci = -z[2*(m-k)+1];
+        er = 0.5 * (zr + cr);  ei = 0.5 * (zi + ci);
+        or_ = 0.5 * (zi - ci); oi = -0.5 * (zr - cr);
+        wr = p->ws[2*k];   wi = p->ws[2*k+1];
+        z[2*k]   = er + (or_ * wr - oi * wi);
+        z[2*k+1] = ei + (or_ * wi + oi * wr);
+        if (k != m-k){
+            /* X[m-k] = conj(E[k]) - W^(m-k) conj(O[k]) ... from the symmetry of E and O */
+            wr = p->ws[2*(m-k)];  wi = p->ws[2*(m-k)+1];
+            z[2*(m-k)]   = er + (or_ * wr + oi * wi);
+            z[2*(m-k)+1] = -ei + (or_ * wi - oi * wr);
+        }
+    }
+}
+
+
+/*--------------------------------------------------------------
+ * function: irfft - Inverse of rfft (in place), unscaled: returns nfft*x in z[0..nfft-1]
+ *-------------------------------------------------------------- */
+static void irfft(double *z, const fft_plan *p){
+    int m = p->nfft / 2, k;
+    double xr, xi, cr, ci, er, ei, dr, di, or_, oi, wr, wi;
+    /* Merge: E[k] = X[k] + conj(X[m-k]), O[k] = (X[k] - conj(X[m-k])) / W^k, Z[k] = E[k] + i*O[k] */
+    for (k=0; k<=m/2; k++){
+        xr = z[2*k];       xi = z[2*k+1];
+        cr = z[2*(m-k)];   ci = -z[2*(m-k)+1];
+        er = xr + cr;      ei = xi + ci;
+        dr = xr - cr;      di = xi - ci;
+        wr = p->ws[2*k];   wi = -p->ws[2*k+1];
+        or_ = dr * wr - di * wi;
+        oi  = dr * wi + di * wr;
+        z[2*k]   = er - oi;
+        z[2*k+1] = ei + or_;
+        if (k != m-k){
+            /* Same for m-k: E[m-k] = conj(E[k]), O[m-k] = conj(O[k]) */
+            z[2*(m-k)]   = er + oi;
+            z[2*(m-k)+1] = -ei + or_;
+        }
+    }
+    cfft(z, m, p->tw, p->rev, 1);
+}
+
+
+/*--------------------------------------------------------------
+ * function: choose_nfft - FFT length minimizing the cost per output sample (depends only on nb)
+ *-------------------------------------------------------------- */
+static int choose_nfft(int nb){
+    int n, best = 0;
+    double cost, bestCost = 0;
+    for (n=256; n<=FF_MAXFFT; n<<=1){
+        if (n < 2*nb) continue;
+        cost = n * log((double) n) / (double) (n - nb + 1);
+        if ((best == 0) || (cost < bestCost)){
+            best = n;
+            bestCost = cost;
+        }
+        if (n >= 64*nb) break;
+    }
+    return best;
+}
+
+
+/*--------------------------------------------------------------
+ * function: get_plan - Returns the FFT plan for filter b, from the cache or computed
+ *-------------------------------------------------------------- */
+static const fft_plan* get_plan(const double *b, int nb){
+    int nfft = choose_nfft(nb), m, i, j, bits, iPlan;
+    fft_plan *p;
+    /* Search the cache */
+    for (iPlan=0; iPlan<FF_NPLANS; iPlan++){
+        p = &plans[iPlan];
+        if ((p->nfft == nfft) && (p->nb == nb) && (memcmp(p->b, b, nb * sizeof(double)) == 0)){
+            return p;
+        }
+    }
+    if (nfft == 0){
+        return NULL;
+    }
+    /* Replace the oldest plan */
+    p = &plans[nextPlan];
+    nextPlan = (nextPlan + 1) % FF_NPLANS;
+    if (p->nfft != 0){
+        mxFree(p->b); mxFree(p->tw); mxFree(p->ws); mxFree(p->rev); mxFree(p->H);
+        p->nfft = 0;
+    }
+    m = nfft / 2;
+    p->b   = (double*) mxMalloc(nb * sizeof(double));
+    p->tw  = (double*) mxMalloc(m * sizeof(double));
+    p->ws  = (double*) mxMalloc((m + 1) * 2 * sizeof(double));
+    p->rev = (int*)    mxMalloc(m * sizeof(int));
+    p->H   = (double*) mxCalloc(nfft + 2, sizeof(double));
+    memcpy(p->b, b, nb * sizeof(double));
+    for (i=0; i<m/2; i++){
+        p->tw[2*i]   = cos(2 * M_PI * i / m);
+        p->tw[2*i+1] = -sin(2 * M_PI * i / m);
+    }
+    for (i=0; i<=m; i++){
+        p->ws[2*i]   = cos(2 * M_PI * i / nfft);
+        p->ws[2*i+1] = -sin(2 * M_PI * i / nfft);
+    }
+    for (bits=0; (1 << bits) < m; bits++);
+    for (i=0; i<m; i++){
+        for (j=0, p->rev[i]=0; j<bits; j++){
+            p->rev[i] |= ((i >> j) & 1) << (bits - 1 - j);
+        }
+    }
+    p->nfft = nfft;
+    p->nb   = nb;
+    /* FFT of the filter, including the scaling of the inverse FFT (1/nfft for the transform, 1/2 for the merge) */
+    memcpy(p->H, b, nb * sizeof(double));
+    rfft(p->H, p);
+    for (i=0; i<nfft+2; i++){
+        p->H[i] /= (double) nfft;
+    }
+    mexMakeMemoryPersistent(p->b);
+    mexMakeMemoryPersistent(p->tw);
+    mexMakeMemoryPersistent(p->ws);
+    mexMakeMemoryPersistent(p->rev);
+    mexMakeMemoryPersistent(p->H);
+    mexAtExit(free_plans);
+    return p;
+}
+
+
+/*--------------------------------------------------------------
+ * function: get_sample - Sample #j of the extended signal [state, x, zeros] for channel c
+ *-------------------------------------------------------------- */
+static double get_sample(const void *S, mwSignedIndex nS, const void *X, mwSignedIndex nX, int nChan, int c, mwSignedIndex j, int isSingle){
+    if (j < nS){
+        return isSingle ? (double) ((const float*) S)[c + j * nChan] : ((const double*) S)[c + j * nChan];
+    }
+    j -= nS;
+    if (j < nX){
+        return isSingle ? (double) ((const float*) X)[c + j * nChan] : ((const double*) X)[c + j * nChan];
+    }
+    return 0;
+}
+
+
+/*--------------------------------------------------------------
+ * function: mexFunction - Entry point from Matlab environment
+ * INPUTS:
+ * nlhs - number of left hand side arguments (outputs)
+ * plhs[] - pointer to table where created matrix pointers are
+ * to be placed
+ * nrhs - number of right hand side arguments (inputs)
+ * prhs[] - pointer to table of input matrices
+ *-------------------------------------------------------------- */
+void mexFunction( int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] ){
+    const char *stateFields[] = {"Buffer", "nSkip"};
+    const fft_plan *p;
+    const mxArray *mxBuf = NULL;
+    mxClassID cls;
+    const void *S = NULL, *X;
+    void *Y;
+    double *b, *work;
+    int nChan, nb, nfft, L, D, nSkip, isLast, isSingle, nThreads, nGroups, g;
+    /* Sample indices and offsets in the [nChan x nTime] arrays: 64-bit on 64-bit platforms */
+    mwSignedIndex nX, nS, nAvail, nBlocks, nProd, nOut, nNew, i;
+
+    /* Input checks */
+    if (nrhs < 2)
+        mexErrMsgTxt("Not enough input arguments.");
+    if (nrhs > 4)
+        mexErrMsgTxt("Too many input arguments.");
+    if (nlhs > 2)
+        mexErrMsgTxt("Too many output arguments.");
+    if ((!mxIsDouble(prhs[0]) && !mxIsSingle(prhs[0])) || mxIsComplex(prhs[0]) || (mxGetNumberOfDimensions(prhs[0]) != 2))
+        mexErrMsgTxt("Argument x must be a real matrix of type double or single.");
+    if (!mxIsDouble(prhs[1]) || mxIsComplex(prhs[1]) || mxIsEmpty(prhs[1]))
+        mexErrMsgTxt("Argument b must be a real vector of type double.");
+    cls      = mxGetClassID(prhs[0]);
+    isSingle = (cls == mxSINGLE_CLASS);
+    nChan    = (int) mxGetM(prhs[0]);
+    nX       = (mwSignedIndex) mxGetN(prhs[0]);
+    nb       = (int) mxGetNumberOfElements(prhs[1]);
+    b        = mxGetPr(prhs[1]);
+    isLast   = (nrhs < 4) || mxIsEmpty(prhs[3]) || (mxGetScalar(prhs[3]) != 0);
+    D        = (nb - 1) / 2;
+    nSkip    = D;
+    nS       = nb - 1;
+    /* State of the filter: previous samples, and samples of the incomplete block */
+    if ((nrhs >= 3) && !mxIsEmpty(prhs[2])){
+        if (!mxIsStruct(prhs[2]) || (mxGetFieldNumber(prhs[2], "Buffer") < 0) || (mxGetFieldNumber(prhs[2], "nSkip") < 0))
+            mexErrMsgTxt("Argument zi must be the state returned by a previous call.");
+        mxBuf = mxGetField(prhs[2], 0, "Buffer");
+        if ((mxBuf == NULL) || (mxGetClassID(mxBuf) != cls) || ((int) mxGetM(mxBuf) != nChan) || ((mwSignedIndex) mxGetN(mxBuf) < nb - 1))
+            mexErrMsgTxt("The state zi does not match the signal or the filter.");
+        nS    = (mwSignedIndex) mxGetN(mxBuf);
+        S     = mxGetData(mxBuf);
+        nSkip = (int) mxGetScalar(mxGetField(prhs[2], 0, "nSkip"));
+    } else {
+        /* Beginning of the signal: the previous samples are zeros */
+        mxBuf = isSingle ? mxCreateNumericMatrix(nChan, nb - 1, mxSINGLE_CLASS, mxREAL) : mxCreateDoubleMatrix(nChan, nb - 1, mxREAL);
+        S = mxGetData(mxBuf);
+    }
+    X = mxGetData(prhs[0]);
+
+    /* FFT plan (the filter is copied: the cache compares the coefficients) */
+    p = get_plan(b, nb);
+    if (p == NULL)
+        mexErrMsgTxt("Filter too long.");
+    nfft = p->nfft;
+    L    = nfft - nb + 1;
+
+    /* Number of blocks: only complete blocks, unless it is the end of the signal (+D zeros for the delay) */
+    nAvail = nS - (nb - 1) + nX;
+    if (isLast){
+        nAvail += D;
+        nBlocks = (nAvail + L - 1) / L;
+        nProd   = nAvail;
+    } else {
+        nBlocks = nAvail / L;
+        nProd   = nBlocks * L;
+    }
+    nOut = nProd - ((nSkip < nProd) ? nSkip : nProd);
+
+    /* Initialize outputs */
+    plhs[0] = mxCreateNumericMatrix(nChan, (mwSize) nOut, cls, mxREAL);
+    Y = mxGetData(plhs[0]);
+    
+    /* Work buffers: one per thread, allocated here (mxMalloc is not thread-safe) */
+#ifdef _OPENMP
+    nThreads = omp_get_max_threads();
+#else
+    nThreads = 1;
+#endif
+    work = (double*) mxMalloc((size_t) nThreads * FF_GROUP * (nfft + 2) * sizeof(double));
+    nGroups = (nChan + FF_GROUP - 1) / FF_GROUP;
+
+    /* Filter the channels by groups */
+    FF_OMP_FOR
+    for (g=0; g<nGroups; g++){
+#ifdef _OPENMP
+        double *buf = work + (size_t) omp_get_thread_num() * FF_GROUP * (nfft + 2);
+#else
+        double *buf = work;
+#endif
+        int c0 = g * FF_GROUP, nc = (nChan - c0 < FF_GROUP) ? (nChan - c0) : FF_GROUP;
+        int c, k, t;
+        mwSignedIndex blk, j0, o;
+        double hr, hi, zr, zi;
+        for (blk=0; blk<nBlocks; blk++){
+            j0 = blk * L;
+            /* Gather [nb-1 previous samples, L new samples]: consecutive channels are contiguous */
+            for (t=0; t<nfft; t++){
+                for (c=0; c<nc; c++){
+                    buf[c * (nfft + 2) + t] = get_sample(S, nS, X, nX, nChan, c0 + c, j0 + t, isSingle);
+                }
+            }
+            for (c=0; c<nc; c++){
+                double *z = buf + c * (nfft + 2);
+                rfft(z, p);
+                /* Product with the FFT of the filter */
+                for (k=0; k<=nfft/2; k++){
+                    hr = p->H[2*k];  hi = p->H[2*k+1];
+                    zr = z[2*k];     zi = z[2*k+1];
+                    z[2*k]   = zr * hr - zi * hi;
+                    z[2*k+1] = zr * hi + zi * hr;
+                }
+                irfft(z, p);
+            }
+            /* Scatter the valid part (last L samples) */
+            for (t=0; t<L; t++){
+                o = j0 + t - nSkip;
+                if ((o < 0) || (j0 + t >= nProd)) continue;
+                for (c=0; c<nc; c++){
+                    if (isSingle){
+                        ((float*) Y)[c0 + c + o * nChan] = (float) buf[c * (nfft + 2) + nb - 1 + t];
+                    } else {
+                        ((double*) Y)[c0 + c + o * nChan] = buf[c * (nfft + 2) + nb - 1 + t];
+                    }
+                }
+            }
+        }
+    }
+    mxFree(work);
+
+    /* New state: nb-1 last samples + samples of the incomplete block */
+    if (nlhs > 1){
+        if (isLast){
+            plhs[1] = mxCreateDoubleMatrix(0, 0, mxREAL);
+        } else {
+            mxArray *mxNew;
+            nNew = nS + nX - nProd;
+            mxNew = mxCreateNumericMatrix(nChan, (mwSize) nNew, cls, mxREAL);
+            for (i=0; i<nNew; i++){
+                mwSignedIndex j = nProd + i;
+                size_t sz = isSingle ? sizeof(float) : sizeof(double);
+                if (j < nS){
+                    memcpy((char*) mxGetData(mxNew) + (size_t) i * nChan * sz, (const char*) S + (size_t) j * nChan * sz, nChan * sz);
+                } else {
+                    memcpy((char*) mxGetData(mxNew) + (size_t) i * nChan * sz, (const char*) X + (size_t) (j - nS) * nChan * sz, nChan * sz);
+                }
+            }
+            plhs[1] = mxCreateStructMatrix(1, 1, 2, stateFields);
+            mxSetField(plhs[1], 0, "Buffer", mxNew);
+            mxSetField(plhs[1], 0, "nSkip", mxCreateDoubleScalar((nSkip > nProd) ? (double) (nSkip - nProd) : 0));
+        }
+    }
+    if ((nrhs < 3) || mxIsEmpty(prhs[2])){
+        mxDestroyArray((mxArray*) mxBuf);
+    }
+} /* end mexFunction() */
@@ -0,0 +1,50 @@
+function varargout = bst_fftfilt(varargin)
+%BST_FFTFILT: Mex-file to filter signals with a FIR filter by overlap-save, with compensation of the delay
+%
+% USAGE:  y = bst_fftfilt(x, b)
+%         [y, zf] = bst_fftfilt(x, b, zi, isLast)
+% 
+% INPUTS: 
+%    - x      : [nChannels x nTime] double or single matrix, filtered along the rows
+%    - b      : FIR filter coefficients (length nb)
+%    - zi     : State of the filter returned by the previous call ([] at the beginning of the signal)
+%    - isLast : If 1, x is the last chunk of the signal (default: 1)
+%
+% OUTPUTS:
+%    - y  : Filtered signals, same class as x, advanced by D=floor((nb-1)/2) samples to compensate the
+%           delay of the linear phase filter: y = filter(b,1,[x,zeros(nChannels,D)],[],2), without the first D samples.
+%           When processing a signal by chunks, only the complete blocks are returned, the following
+%           samples are returned by the next calls. The concatenation of all the outputs has the same
+%           size as the concatenation of the inputs, and is identical to the output of one single call.
+%    - zf : State of the filter, to pass to the next call
+%
+% EXAMPLE: Filter a file by chunks
+%    zf = [];
+%    for i = 1:nChunks
+%        [y, zf] = bst_fftfilt(x{i}, b, zf, i == nChunks);
+%        ...
+%    end
+% 
+% COMPILE:
+%    mex -v bst_fftfilt.c
+%    Multithreaded (Linux): mex -v CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" bst_fftfilt.c
+
+% @=============================================================================
+% This function is part of the Brainstorm software:
+% https://neuroimage.usc.edu/brainstorm
+% 
+% Copyright (c) University of Southern California & McGill University
+% This software is distributed under the terms of the GNU General Public License
+% as published by the Free Software Foundation. Further details on the GPLv3
+% license can be found at http://www.gnu.org/copyleft/gpl.html.
+% 
+% FOR RESEARCH PURPOSES ONLY. THE SOFTWARE IS PROVIDED "AS IS," AND THE
+% UNIVERSITY OF SOUTHERN CALIFORNIA AND ITS COLLABORATORS DO NOT MAKE ANY
+% WARRANTY, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO WARRANTIES OF
+% MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, NOR DO THEY ASSUME ANY
+% LIABILITY OR RESPONSIBILITY FOR THE USE OF THIS SOFTWARE.
+%
+% For more information type "brainstorm license" at command prompt.
+% =============================================================================@
+
+error('Mex-function bst_fftfilt.c not compiled.');
@@ -1,11 +1,216 @@
 /*--------------------------------------------------------------
- * file: bst_meanvar.c - Mean and variance estimation along first dimension with imprecise algorithm
- *                       Excludes the zero values from the computation
- *                   
+ * file: bst_meanvar.c - Mean and variance estimation along first dimension
+ *                       Single pass over the data, numerically stable (blocked Welford/Chan updates)
+ *                       Optionally excludes the zero values from the computation
+ *
  * [mean,var,nAvg] = bst_meanvar(x, isZeroBad)
+ *
+ * INPUTS:
+ *    - x         : [MxN] double, single, int16 or int32 matrix (accumulation is always done in double)
+ *    - isZeroBad : If 1, excludes all the zero values from the computation (default: 0)
+ * OUTPUTS:
+ *    - mean : [1xN] averages values
+ *    - var  : [1xN] unbiased estimator of the variance
+ *    - nAvg : [1xN] number of values that were averaged
+ *
+ * Each column is processed by blocks of MV_BLOCK values: the mean and the sum of squared
+ * deviations of a block are computed while the block is in the L1 cache, then merged with
+ * the running statistics of the column (Chan et al. 1979). The memory is read only once,
+ * and the error does not grow with the length of the columns as with the sum of squares.
+ * The columns are distributed over the available cores when compiled with OpenMP.
+ * The block kernel uses AVX2 when the CPU supports it (GCC/Clang on x86), the columns being
+ * contiguous in memory, the vectorization is done along each column.
  *-------------------------------------------------------------- */
 #include <math.h>
 #include "mex.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MV_USE_AVX2
+#include <immintrin.h>
+#endif
+
+/* Compile with:
+ * mex -v bst_meanvar.c
+ * or with OpenMP (Linux):
+ * mex -v CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" bst_meanvar.c */
+
+/* Number of values processed together (fits in the L1 cache once converted to double) */
+#define MV_BLOCK 512
+
+/* Block statistics: number of good values, mean, sum of squared deviations */
+typedef void (*block_fcn)(const double *x, int n, int isZeroBad, double *cnt, double *mean, double *m2);
+
+
+/*--------------------------------------------------------------
+ * function: block_stats - Statistics of one block (portable version)
+ *-------------------------------------------------------------- */
+static void block_stats(const double *x, int n, int isZeroBad, double *cnt, double *mean, double *m2){
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0, c = 0, m, d, v = 0;
+    int i;
+    /* Sum: four accumulators to break the dependency chain */
+    if (isZeroBad){
+        for (i=0; i+3<n; i+=4){
+            s0 += x[i];   c += (x[i] != 0);
+            s1 += x[i+1]; c += (x[i+1] != 0);
+            s2 += x[i+2]; c += (x[i+2] != 0);
+            s3 += x[i+3]; c += (x[i+3] != 0);
+        }
+        for (; i<n; i++){
+            s0 += x[i];   c += (x[i] != 0);
+        }
+    } else {
+        for (i=0; i+3<n; i+=4){
+            s0 += x[i]; s1 += x[i+1]; s2 += x[i+2]; s3 += x[i+3];
+        }
+        for (; i<n; i++){
+            s0 += x[i];
+        }
+        c = n;
+    }
+    *cnt = c;
+    if (c == 0){
+        *mean = 0;
+        *m2   = 0;
+        return;
+    }
+    /* Zeros do not contribute to the sum, but they must be excluded from the deviations */
+    m = ((s0 + s1) + (s2 + s3)) / c;
+    for (i=0; i<n; i++){
+        if (!isZeroBad || (x[i] != 0)){
+            d = x[i] - m;
+            v += d * d;
+        }
+    }
+    *mean = m;
+    *m2   = v;
+}
+
+
+#ifdef MV_USE_AVX2
+/*--------------------------------------------------------------
+ * function: block_stats_avx2 - Statistics of one block (AVX2 version)
+ *-------------------------------------------------------------- */
+__attribute__((target("avx2")))
+static void block_stats_avx2(const double *x, int n, int isZeroBad, double *cnt, double *mean, double *m2){
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one  = _mm256_set1_pd(1.0);
+    __m256d vs0 = zero, vs1 = zero, vc = zero, vm, vv0 = zero, vv1 = zero;
+    __m256d a, b, ma, mb;
+    double buf[4], s, c, m, v, d;
+    int i;
+
+    /* Sum and count */
+    for (i=0; i+7<n; i+=8){
+        a = _mm256_loadu_pd(x + i);
+        b = _mm256_loadu_pd(x + i + 4);
+        vs0 = _mm256_add_pd(vs0, a);
+        vs1 = _mm256_add_pd(vs1, b);
+        if (isZeroBad){
+            /* Unordered compare: NaN counts as a good value, as in the scalar version */
+            ma = _mm256_cmp_pd(a, zero, _CMP_NEQ_UQ);
+            mb = _mm256_cmp_pd(b, zero, _CMP_NEQ_UQ);
+            vc = _mm256_add_pd(vc, _mm256_add_pd(_mm256_and_pd(ma, one), _mm256_and_pd(mb, one)));
+        }
+    }
+    _mm256_storeu_pd(buf, _mm256_add_pd(vs0, vs1));
+    s = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+    if (isZeroBad){
+        _mm256_storeu_pd(buf, vc);
+        c = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+        for (; i<n; i++){
+            s += x[i];
+            c += (x[i] != 0);
+        }
+    } else {
+        for (; i<n; i++){
+            s += x[i];
+        }
+        c = n;
+    }
+    *cnt = c;
+    if (c == 0){
+        *mean = 0;
+        *m2   = 0;
+        return;
+    }
+    m = s / c;
+
+    /* Sum of squared deviations */
+    vm = _mm256_set1_pd(m);
+    for (i=0; i+7<n; i+=8){
+        a = _mm256_loadu_pd(x + i);
+        b = _mm256_loadu_pd(x + i + 4);
+        ma = _mm256_sub_pd(a, vm);
+        mb = _mm256_sub_pd(b, vm);
+        if (isZeroBad){
+            ma = _mm256_and_pd(ma, _mm256_cmp_pd(a, zero, _CMP_NEQ_UQ));
+            mb = _mm256_and_pd(mb, _mm256_cmp_pd(b, zero, _CMP_NEQ_UQ));
+        }
+        vv0 = _mm256_add_pd(vv0, _mm256_mul_pd(ma, ma));
+        vv1 = _mm256_add_pd(vv1, _mm256_mul_pd(mb, mb));
+    }
+    _mm256_storeu_pd(buf, _mm256_add_pd(vv0, vv1));
+    v = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+    for (; i<n; i++){
+        if (!isZeroBad || (x[i] != 0)){
+            d = x[i] - m;
+            v += d * d;
+        }
+    }
+    *mean = m;
+    *m2   = v;
+}
+#endif
+
+
+/*--------------------------------------------------------------
+ * Column loop, for each input type: converts blocks to double and merges the block statistics
+ *-------------------------------------------------------------- */
+#define MV_COLUMN_LOOP(TYPE, ISDOUBLE)                                              \
+    {                                                                               \
+        const TYPE *X = (const TYPE*) mxGetData(prhs[0]);                           \
+        int j;                                                                      \
+        MV_OMP_FOR                                                                  \
+        for (j=0; j<N; j++){                                                        \
+            const TYPE *col = X + (size_t) j * M;                                   \
+            double buf[MV_BLOCK];                                                   \
+            double n = 0, m = 0, v = 0, nb, mb, vb, delta, nt;                      \
+            int i0, nBlock, i;                                                      \
+            for (i0=0; i0<M; i0+=MV_BLOCK){                                         \
+                const double *xb;                                                   \
+                nBlock = (M - i0 < MV_BLOCK) ? (M - i0) : MV_BLOCK;                 \
+                if (ISDOUBLE){                                                      \
+                    xb = (const double*) (col + i0);                                \
+                } else {                                                            \
+                    for (i=0; i<nBlock; i++) buf[i] = (double) col[i0 + i];         \
+                    xb = buf;                                                       \
+                }                                                                   \
+                fcn(xb, nBlock, isZeroBad, &nb, &mb, &vb);                          \
+                if (nb == 0) continue;                                              \
+                /* Merge with the running statistics (Chan et al.) */               \
+                nt    = n + nb;                                                     \
+                delta = mb - m;                                                     \
+                m    += delta * (nb / nt);                                          \
+                v    += vb + delta * delta * (n * nb / nt);                         \
+                n     = nt;                                                         \
+            }                                                                       \
+            mean[j] = m;                                                            \
+            nAvg[j] = n;                                                            \
+            /* Unbiased estimator, averaging at least two values */                 \
+            var[j]  = (n > 1) ? v / (n - 1) : 0;                                    \
+        }                                                                           \
+    }
+
+#if defined(_OPENMP) && defined(_MSC_VER)
+#define MV_OMP_FOR __pragma(omp parallel for schedule(static))
+#elif defined(_OPENMP)
+#define MV_OMP_FOR _Pragma("omp parallel for schedule(static)")
+#else
+#define MV_OMP_FOR
+#endif
+
 
 /*--------------------------------------------------------------
  * function: mexFunction - Entry point from Matlab environment
@@ -16,37 +221,37 @@
  * nrhs - number of right hand side arguments (inputs)
  * prhs[] - pointer to table of input matrices
  *-------------------------------------------------------------- */
-
-/* Compile with: 
- * mex -v bst_meanvar.c */
-
 void mexFunction( int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] ){
-    double *x, *mean, *var, *param, *nAvg;
-    int j, N, M, isZeroBad;
-    
+    double *mean, *var, *nAvg;
+    int N, M, isZeroBad;
+    block_fcn fcn = block_stats;
+
 	/* Input checks */
     if (nrhs < 1)
         mexErrMsgTxt("Not enough input arguments.");
     if (nrhs > 2)
         mexErrMsgTxt("Too many input arguments.");
-    if ((!mxIsDouble(prhs[0])) || (!mxIsDouble(prhs[1])))
-        mexErrMsgTxt("Arguments must be type double.");
+    if (!mxIsDouble(prhs[0]) && !mxIsSingle(prhs[0]) && !mxIsClass(prhs[0], "int16") && !mxIsClass(prhs[0], "int32"))
+        mexErrMsgTxt("Argument x must be of type double, single, int16 or int32.");
     if (mxIsComplex(prhs[0]) || ((nrhs > 1) && (mxIsComplex(prhs[1]))))
         mexWarnMsgTxt("Complex parts ignored.");
-		
+
     /* Get input data */
-    x = mxGetPr(prhs[0]);
-    M = mxGetM(prhs[0]);   /* Signals to average */
-    N = mxGetN(prhs[0]);   /* Independent measurements */
+    M = (int) mxGetM(prhs[0]);   /* Signals to average */
+    N = (int) mxGetN(prhs[0]);   /* Independent measurements */
 	/* Additional parameters */
-    param = mxGetPr(prhs[1]);
-	if (param[0] == 0){
+	if ((nrhs < 2) || mxIsEmpty(prhs[1]) || (mxGetScalar(prhs[1]) == 0)){
 		isZeroBad = 0;
 	} else {
 		isZeroBad = 1;
 	}
-	
-	
+#ifdef MV_USE_AVX2
+    /* Runtime CPU dispatch */
+    if (__builtin_cpu_supports("avx2")){
+        fcn = block_stats_avx2;
+    }
+#endif
+
     /* Initialize outputs */
     plhs[0] = mxCreateDoubleMatrix(1,N,mxREAL);
 	plhs[1] = mxCreateDoubleMatrix(1,N,mxREAL);
@@ -54,36 +259,14 @@ void mexFunction( int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] ){
     mean = mxGetPr(plhs[0]);
 	var  = mxGetPr(plhs[1]);
 	nAvg = mxGetPr(plhs[2]);
-    
-    /* Mean/Variance computation */
-	/* Loop on indendent measurements */
-    for (j=0; j<N; j++){
-        double vA = 0.0;    
-        int i;
-		
-        /* Mean:  Loop on signals to average */
-        for (i=0; i<M; i++) {
-		    if ((isZeroBad == 0) || (x[i + j*M] != 0)){
-				mean[j] += x[i + j*M];
-				nAvg[j] += 1;
-			}
-		}
-		/* Averaging at least two values */
-		if (nAvg[j] > 1){
-		    /* Finish the computation of the average */
-		    mean[j] = mean[j] / nAvg[j];
-			/* Variance:  Loop on signals to average */
-			for (i=0; i<M; i++) {
-				if (x[i + j*M] != 0){
-					vA = (x[i + j*M] - mean[j]);
-					var[j] += vA * vA;
-				}
-			}
-			/* Unbiased estimator */
-			var[j] = var[j] / (nAvg[j]-1);
-		} else {
-			var[j] = 0;
-		}
+
+    /* Mean/Variance computation: loop on independent measurements */
+    switch (mxGetClassID(prhs[0])){
+        case mxDOUBLE_CLASS:  MV_COLUMN_LOOP(double, 1);  break;
+        case mxSINGLE_CLASS:  MV_COLUMN_LOOP(float,  0);  break;
+        case mxINT16_CLASS:   MV_COLUMN_LOOP(short,  0);  break;
+        case mxINT32_CLASS:   MV_COLUMN_LOOP(int,    0);  break;
+        default: break;
     }
 
 } /* end mexFunction() */
@@ -1,19 +1,21 @@
 function varargout = bst_meanvar(varargin)
-%BST_MEANVAR: Mex-file to compute mean and variance along first dimension (with imprecise algorithm)
+%BST_MEANVAR: Mex-file to compute mean and variance along first dimension (single pass, numerically stable)
 %
-% USAGE: [mean,var,nAvg] = bst_meanvar(x, isZeroBad)
+% USAGE: [mean,var,nAvg] = bst_meanvar(x, isZeroBad=0)
 % 
 % INPUTS: 
-%    - x         : [NxM] double matrix with values to process
+%    - x         : [NxM] double, single, int16 or int32 matrix with values to process
+%                  (no need to convert to double: the accumulation is always done in double precision)
 %    - isZeroBad : If 1, excludes all the zero values from the computation
 %
 % OUTPUTS:
 %    - mean : [1xM] averages values 
-%    - var  : [1xM] unbiased estimator of the variance (computed with an algorithm prone to rounding errors)
-%    - nAvg : [1xM] number of non-zero values that were averaged
+%    - var  : [1xM] unbiased estimator of the variance
+%    - nAvg : [1xM] number of values that were averaged (non-zero values if isZeroBad=1)
 % 
 % COMPILE:
 %    mex -v bst_meanvar.c
+%    Multithreaded (Linux): mex -v CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" bst_meanvar.c
 
 % @=============================================================================
 % This function is part of the Brainstorm software:
@@ -1,7 +1,7 @@
-function [pv,S0,nGoodA,nGoodB,PS] = bst_permtest(A, B, TestType, dimPerm, nPerm, tails, isZeroBad)
+function [pv,S0,nGoodA,nGoodB,PS,maxS] = bst_permtest(A, B, TestType, dimPerm, nPerm, tails, isZeroBad)
 % PERMTEST: Generic randomization test.
 %
-% USAGE:  [pv,S0,nGoodA,nGoodB,PS] = bst_permtest(A, B, TestType, dimPerm, nPerm, tails, isZeroBad)
+% USAGE:  [pv,S0,nGoodA,nGoodB,PS,maxS] = bst_permtest(A, B, TestType, dimPerm, nPerm, tails, isZeroBad)
 %
 % INPUTS:
 %    - A, B     : [Ma x Mb...] Variables to test   
@@ -23,6 +23,10 @@ function [pv,S0,nGoodA,nGoodB,PS] = bst_permtest(A, B, TestType, dimPerm, nPerm,
 %    - nGoodA: [Ma x Mb...] Number of good samples for each set of measures in A
 %    - nGoodB: [Ma x Mb...] Number of good samples for each set of measures in B
 %    - PS    : [P x Ma x Mb... ] Matrix of permutation statistics (may be quite big!)
+%    - maxS  : [P x 1] Max-statistic null distribution: max(|S|) for 'two', max(S) for 'one+', min(S) for 'one-'
+%
+% NOTE: The t-tests and 'absmean' are computed with the compiled function bst_permtest_mex.c,
+%       which evaluates all the permutations in one single multithreaded pass.
 
 % @=============================================================================
 % This function is part of the Brainstorm software:
@@ -65,12 +69,6 @@ nGoodA = [];
 nGoodB = [];
 % Concatenate two input variables
 X = cat(1, A, B);
-% Try to compile the needed mex function
-if (exist('bst_meanvar', 'file') ~= 3)
-    if ~bst_compile_mex('toolbox/math/bst_meanvar', 0)
-        error('Cannot compile mex function bst_meanvar.c...');
-    end
-end
 % Compute indices of (x,y,z) orientations for unconstrained sources
 if strcmpi(TestType, 'absmean_unconstr')
     % Oriention X
@@ -100,7 +98,42 @@ else
 end
 
 
+% ===== COMPILED PERMUTATION LOOP =====
+% Tests supported by the compiled function
+isMexTest = ismember(TestType, {'ttest_equal', 'ttest_unequal', 'ttest_paired', 'absmean'}) && (isa(X,'double') || isa(X,'single')) && isreal(X);
+if isMexTest && (exist('bst_permtest_mex', 'file') ~= 3)
+    isMexTest = bst_compile_mex('toolbox/math/bst_permtest_mex', 0, 1);
+end
+if isMexTest
+    bst_progress('text', sprintf('Randomizations:  %d permutations (compiled)...', nPerm));
+    % All the permutations in one call: X is read only once
+    X = reshape(X, size(X,1), []);
+    if (nargout >= 5)
+        [S,S0,nGoodA,nGoodB,maxS,PS] = bst_permtest_mex(X, P, nA, TestType, tails, isZeroBad);
+        PS = reshape(PS, [nPerm, sizeData, 1]);
+    else
+        [S,S0,nGoodA,nGoodB,maxS] = bst_permtest_mex(X, P, nA, TestType, tails, isZeroBad);
+    end
+    % Restore the dimensions of the data
+    S  = reshape(S,  [sizeData, 1]);
+    S0 = reshape(S0, [sizeData, 1]);
+    nGoodA = reshape(nGoodA, [sizeData, 1]);
+    if ~isempty(nGoodB)
+        nGoodB = reshape(nGoodB, [sizeData, 1]);
+    end
+    % Compute resulting p-values
+    pv = (S+1) ./ (nPerm+1);
+    return;
+end
+
+
 % ===== PERMUTATION LOOP =====
+% Try to compile the needed mex function (if it is not available: slower Matlab version)
+% The binaries of the previous version of bst_meanvar.c only accept double values, and are correct only with isZeroBad=1
+[isMexMeanVar, isLegacyMeanVar] = bst_compile_mex('toolbox/math/bst_meanvar', 0, 1, '', @CheckMeanVarMex);
+if ~isMexMeanVar && isLegacyMeanVar && isZeroBad
+    isMexMeanVar = 2;
+end
 tic;
 for i = 0:nPerm
     % Count time per iteration
@@ -132,8 +165,8 @@ for i = 0:nPerm
     switch (TestType)
         case {'ttest_equal', 'ttest_unequal', 'absmean', 'absmean_unconstr'}  % INDEPENDENT
             % Compute mean and variance
-            [mA,vA,nAvgA] = bst_meanvar(double(X(iA,:)), isZeroBad);
-            [mB,vB,nAvgB] = bst_meanvar(double(X(iB,:)), isZeroBad);
+            [mA,vA,nAvgA] = MeanVar(X(iA,:), isZeroBad, isMexMeanVar);
+            [mB,vB,nAvgB] = MeanVar(X(iB,:), isZeroBad, isMexMeanVar);
             % Convert number of good samples to double
             nAvgA = double(nAvgA);
             nAvgB = double(nAvgB);
@@ -167,7 +200,7 @@ for i = 0:nPerm
             % Compute difference of pairs (A-B)
             D = X(iA,:) - X(iB,:);
             % Compute mean and variance
-            [mD,vD,nAvgA] = bst_meanvar(double(D), isZeroBad);
+            [mD,vD,nAvgA] = MeanVar(D, isZeroBad, isMexMeanVar);
             % Convert number of good samples to double
             nAvgA = double(nAvgA);
             % Remove null variances
@@ -220,6 +253,8 @@ for i = 0:nPerm
             ixP(:) = {':'};
             PS = zeros([nPerm, sizeData, 1],'single');
         end
+        % Max-statistic null distribution
+        maxS = zeros(nPerm, 1);
         % Count all good and bad channels for each set
         if ~isempty(nAvgA)
             nGoodA = reshape(nAvgA, sizeData);
@@ -237,6 +272,12 @@ for i = 0:nPerm
             case 'two'
                 S = S + (abs(Z) >= abs(S0));
         end
+        % Max-statistic null distribution
+        switch (tails)
+            case 'one-',  maxS(i) = min(Z(:));
+            case 'one+',  maxS(i) = max(Z(:));
+            case 'two',   maxS(i) = max(abs(Z(:)));
+        end
         % Save statistics for all the permutations
         if (nargout >= 5)
             PS(i,ixP{:}) = Z;
@@ -249,3 +290,41 @@ pv = (S+1) ./ (nPerm+1);
 
 
 
+%% ===== MEAN AND VARIANCE =====
+% Mean and variance along the first dimension: bst_meanvar, or the same computation in Matlab
+% (bst_meanvar reads double, single and int16 matrices directly, without conversion)
+% isMex: 0=Matlab, 1=bst_meanvar, 2=previous version of bst_meanvar (double only)
+function [m, v, n] = MeanVar(x, isZeroBad, isMex)
+    if (isMex == 2)
+        [m, v, n] = bst_meanvar(double(x), isZeroBad);
+        return;
+    elseif isMex
+        [m, v, n] = bst_meanvar(x, isZeroBad);
+        return;
+    end
+    x = double(x);
+    if isZeroBad
+        iGood = (x ~= 0);
+        n = sum(iGood, 1);
+    else
+        iGood = [];
+        n = size(x,1) * ones(1, size(x,2));
+    end
+    % Mean (0 if there are no good values)
+    m = sum(x, 1) ./ max(n, 1);
+    % Unbiased estimator of the variance (0 if there are less than two good values)
+    d = bsxfun(@minus, x, m);
+    if isZeroBad
+        d(~iGood) = 0;
+    end
+    v = sum(d.^2, 1) ./ max(n - 1, 1);
+    v(n < 2) = 0;
+end
+
+
+%% ===== CHECK BST_MEANVAR =====
+% Previous versions of bst_meanvar: double values only, zeros excluded from the variance even with isZeroBad=0
+function isOk = CheckMeanVarMex()
+    [m, v] = bst_meanvar(single([1;0;3;0]), 0);
+    isOk = (m == 1) && (v == 2);
+end
@@ -0,0 +1,321 @@
+/*--------------------------------------------------------------
+ * file: bst_permtest_mex.c - Fused permutation loop for bst_permtest
+ *                            (t-tests and absmean, all the permutations in one pass)
+ *
+ * [S, S0, nGoodA, nGoodB, maxS, PS] = bst_permtest_mex(X, P, nA, TestType, tails, isZeroBad)
+ *
+ * INPUTS:
+ *    - X         : [nA+nB x N] double or single matrix, samples A followed by samples B
+ *    - P         : [nPerm x nA+nB] double matrix of row indices in X (1-based)
+ *                  P(i,1:nA) = rows of group A, P(i,nA+1:end) = rows of group B
+ *    - nA        : Number of samples in group A
+ *    - TestType  : {'ttest_equal', 'ttest_unequal', 'ttest_paired', 'absmean'}
+ *    - tails     : {'one-', 'one+', 'two'}
+ *    - isZeroBad : If 1, excludes zeros from all the calculations
+ *
+ * OUTPUTS:
+ *    - S      : [1 x N] Number of permutations where the statistic exceeds the observed one
+ *    - S0     : [1 x N] Observed values of the statistic
+ *    - nGoodA : [1 x N] Number of good samples in A (paired: number of good differences)
+ *    - nGoodB : [1 x N] Number of good samples in B (empty for paired tests)
+ *    - maxS   : [nPerm x 1] Max-statistic null distribution (max|Z| for 'two', max(Z) for 'one+', min(Z) for 'one-')
+ *    - PS     : [nPerm x N] single matrix with all the permutation statistics (only if requested)
+ *
+ * Each column of X is copied once to a local buffer and all the permutations are
+ * evaluated on it, no sub-matrix is ever copied. The columns are distributed
+ * over the available cores when compiled with OpenMP.
+ *-------------------------------------------------------------- */
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include "mex.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Compile with:
+ * mex -v bst_permtest_mex.c
+ * or with OpenMP (Linux):
+ * mex -v CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" bst_permtest_mex.c */
+
+/* Test types */
+#define TEST_TTEST_EQUAL    0
+#define TEST_TTEST_UNEQUAL  1
+#define TEST_TTEST_PAIRED   2
+#define TEST_ABSMEAN        3
+/* Tails */
+#define TAIL_ONE_MINUS  0
+#define TAIL_ONE_PLUS   1
+#define TAIL_TWO        2
+
+
+/*--------------------------------------------------------------
+ * function: meanvar_idx - Mean/variance of x(idx), two passes on a cached column
+ *-------------------------------------------------------------- */
+static void meanvar_idx(const double *x, const int *idx, int n, int isZeroBad,
+                        double *mean, double *var, double *nAvg){
+    double s = 0.0, v = 0.0, d;
+    int i, k = 0;
+    /* Mean */
+    for (i=0; i<n; i++){
+        d = x[idx[i]];
+        if (!isZeroBad || (d != 0)){
+            s += d;
+            k++;
+        }
+    }
+    *nAvg = (double) k;
+    *mean = (k > 0) ? s / k : 0.0;
+    /* Averaging at least two values */
+    if (k > 1){
+        for (i=0; i<n; i++){
+            d = x[idx[i]];
+            if (!isZeroBad || (d != 0)){
+                d -= *mean;
+                v += d * d;
+            }
+        }
+        /* Unbiased estimator */
+        *var = v / (k - 1);
+    } else {
+        *var = 0.0;
+    }
+}
+
+/*--------------------------------------------------------------
+ * function: column_stat - Statistic for one column and one permutation
+ *-------------------------------------------------------------- */
+static double column_stat(const double *x, const int *iA, const int *iB, int nA, int nB,
+                          int testType, int isZeroBad, double *dbuf, double *nAvgA, double *nAvgB){
+    double mA, vA, mB, vB, pvar;
+    int i;
+
+    if (testType == TEST_TTEST_PAIRED){
+        /* Difference of pairs (A-B), then mean/variance of the difference */
+        for (i=0; i<nA; i++){
+            dbuf[i] = x[iA[i]] - x[iB[i]];
+        }
+        {
+            double mD = 0.0, vD = 0.0, d;
+            int k = 0;
+            for (i=0; i<nA; i++){
+                if (!isZeroBad || (dbuf[i] != 0)){
+                    mD += dbuf[i];
+                    k++;
+                }
+            }
+            *nAvgA = (double) k;
+            *nAvgB = 0.0;
+            if (k <= 1){
+                return 0.0;
+            }
+            mD /= k;
+            for (i=0; i<nA; i++){
+                if (!isZeroBad || (dbuf[i] != 0)){
+                    d = dbuf[i] - mD;
+                    vD += d * d;
+                }
+            }
+            vD /= (k - 1);
+            /* Null variance: statistic set to zero */
+            if (vD == 0){
+                return 0.0;
+            }
+            return mD / sqrt(vD / k);
+        }
+    }
+
+    /* Independent tests */
+    meanvar_idx(x, iA, nA, isZeroBad, &mA, &vA, nAvgA);
+    meanvar_idx(x, iB, nB, isZeroBad, &mB, &vB, nAvgB);
+    /* Null variances: statistic set to zero */
+    if ((vA == 0) || (vB == 0)){
+        return 0.0;
+    }
+    switch (testType){
+        case TEST_TTEST_EQUAL:
+            pvar = ((*nAvgA - 1) * vA + (*nAvgB - 1) * vB) / (*nAvgA + *nAvgB - 2);
+            return (mA - mB) / sqrt(pvar * (1.0 / *nAvgA + 1.0 / *nAvgB));
+        case TEST_TTEST_UNEQUAL:
+            return (mA - mB) / sqrt(vA / *nAvgA + vB / *nAvgB);
+        case TEST_ABSMEAN:
+            return (fabs(mA) - fabs(mB)) / sqrt(vA / *nAvgA + vB / *nAvgB);
+    }
+    return 0.0;
+}
+
+
+/*--------------------------------------------------------------
+ * function: mexFunction - Entry point from Matlab environment
+ *-------------------------------------------------------------- */
+void mexFunction( int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] ){
+    const double *Pd;
+    double *S, *S0, *nGoodA, *nGoodB, *maxS, *maxThread;
+    float *PS = NULL;
+    int *perm, *iRef;
+    char strType[32], strTail[8];
+    int nRows, N, nPerm, nA, nB, testType, tail = TAIL_TWO, isZeroBad, isSingle, nThreads;
+    int i, k;
+
+    /* Input checks */
+    if (nrhs != 6)
+        mexErrMsgTxt("Usage: [S,S0,nGoodA,nGoodB,maxS,PS] = bst_permtest_mex(X, P, nA, TestType, tails, isZeroBad)");
+    if ((!mxIsDouble(prhs[0]) && !mxIsSingle(prhs[0])) || mxIsComplex(prhs[0]))
+        mexErrMsgTxt("X must be a real double or single matrix.");
+    if (!mxIsDouble(prhs[1]) || mxIsComplex(prhs[1]))
+        mexErrMsgTxt("P must be a real double matrix.");
+    if (!mxIsChar(prhs[3]) || !mxIsChar(prhs[4]))
+        mexErrMsgTxt("TestType and tails must be strings.");
+
+    /* Get input data */
+    nRows    = (int) mxGetM(prhs[0]);
+    N        = (int) mxGetN(prhs[0]);
+    isSingle = mxIsSingle(prhs[0]);
+    nPerm    = (int) mxGetM(prhs[1]);
+    nA       = (int) mxGetScalar(prhs[2]);
+    nB       = (int) mxGetN(prhs[1]) - nA;
+    isZeroBad = (mxGetScalar(prhs[5]) != 0);
+    if ((nA < 1) || (nB < 1) || (nA + nB != nRows))
+        mexErrMsgTxt("Size of P does not match the size of X.");
+    /* Test type */
+    mxGetString(prhs[3], strType, sizeof(strType));
+    if      (!strcmp(strType, "ttest_equal"))   testType = TEST_TTEST_EQUAL;
+    else if (!strcmp(strType, "ttest_unequal")) testType = TEST_TTEST_UNEQUAL;
+    else if (!strcmp(strType, "ttest_paired"))  testType = TEST_TTEST_PAIRED;
+    else if (!strcmp(strType, "absmean"))       testType = TEST_ABSMEAN;
+    else mexErrMsgTxt("Unsupported test type.");
+    if ((testType == TEST_TTEST_PAIRED) && (nA != nB))
+        mexErrMsgTxt("Paired tests require the same number of samples in A and B.");
+    /* Tails */
+    mxGetString(prhs[4], strTail, sizeof(strTail));
+    if      (!strcmp(strTail, "one-")) tail = TAIL_ONE_MINUS;
+    else if (!strcmp(strTail, "one+")) tail = TAIL_ONE_PLUS;
+    else if (!strcmp(strTail, "two"))  tail = TAIL_TWO;
+    else mexErrMsgTxt("Invalid tails.");
+
+    /* Convert permutation matrix to 0-based indices, one contiguous row per permutation */
+    Pd   = mxGetPr(prhs[1]);
+    perm = (int*) mxMalloc((size_t) nPerm * nRows * sizeof(int));
+    for (i=0; i<nPerm; i++){
+        for (k=0; k<nRows; k++){
+            double p = Pd[i + (size_t) k * nPerm];
+            if ((p < 1) || (p > nRows))
+                mexErrMsgTxt("Invalid index in permutation matrix P.");
+            perm[(size_t) i * nRows + k] = (int) p - 1;
+        }
+    }
+    /* Indices of the original data */
+    iRef = (int*) mxMalloc(nRows * sizeof(int));
+    for (k=0; k<nRows; k++){
+        iRef[k] = k;
+    }
+
+    /* Initialize outputs */
+    plhs[0] = mxCreateDoubleMatrix(1, N, mxREAL);
+    plhs[1] = mxCreateDoubleMatrix(1, N, mxREAL);
+    plhs[2] = mxCreateDoubleMatrix(1, N, mxREAL);
+    plhs[3] = mxCreateDoubleMatrix((testType == TEST_TTEST_PAIRED) ? 0 : 1, (testType == TEST_TTEST_PAIRED) ? 0 : N, mxREAL);
+    plhs[4] = mxCreateDoubleMatrix(nPerm, 1, mxREAL);
+    S      = mxGetPr(plhs[0]);
+    S0     = mxGetPr(plhs[1]);
+    nGoodA = mxGetPr(plhs[2]);
+    nGoodB = (testType == TEST_TTEST_PAIRED) ? NULL : mxGetPr(plhs[3]);
+    maxS   = mxGetPr(plhs[4]);
+    if (nlhs >= 6){
+        plhs[5] = mxCreateNumericMatrix(nPerm, N, mxSINGLE_CLASS, mxREAL);
+        PS = (float*) mxGetData(plhs[5]);
+    }
+
+    /* Per-thread buffers (allocated here: mxMalloc is not thread-safe) */
+#ifdef _OPENMP
+    nThreads = omp_get_max_threads();
+#else
+    nThreads = 1;
+#endif
+    maxThread = (double*) mxMalloc((size_t) nThreads * (nPerm > 0 ? nPerm : 1) * sizeof(double));
+    for (i=0; i<nThreads*nPerm; i++){
+        maxThread[i] = (tail == TAIL_ONE_MINUS) ? HUGE_VAL : -HUGE_VAL;
+    }
+    {
+        double *colBuf = (double*) mxMalloc((size_t) nThreads * 2 * nRows * sizeof(double));
+        const void *X = mxGetData(prhs[0]);
+
+        /* Loop on independent measurements: each column is read once, for all the permutations */
+#ifdef _OPENMP
+        #pragma omp parallel num_threads(nThreads)
+#endif
+        {
+#ifdef _OPENMP
+            int iThread = omp_get_thread_num();
+#else
+            int iThread = 0;
+#endif
+            double *x    = colBuf + (size_t) iThread * 2 * nRows;
+            double *dbuf = x + nRows;
+            double *tmax = maxThread + (size_t) iThread * nPerm;
+            int j;
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic, 16)
+#endif
+            for (j=0; j<N; j++){
+                double z0, z, nAvgA, nAvgB, count = 0.0;
+                int ip, r;
+                /* Local copy of the column, converted to double */
+                if (isSingle){
+                    const float *xs = (const float*) X + (size_t) j * nRows;
+                    for (r=0; r<nRows; r++) x[r] = (double) xs[r];
+                } else {
+                    memcpy(x, (const double*) X + (size_t) j * nRows, nRows * sizeof(double));
+                }
+                /* Observed statistic */
+                z0 = column_stat(x, iRef, iRef + nA, nA, nB, testType, isZeroBad, dbuf, &nAvgA, &nAvgB);
+                S0[j] = z0;
+                nGoodA[j] = nAvgA;
+                if (nGoodB){
+                    nGoodB[j] = nAvgB;
+                }
+                /* Permutations */
+                for (ip=0; ip<nPerm; ip++){
+                    const int *p = perm + (size_t) ip * nRows;
+                    z = column_stat(x, p, p + nA, nA, nB, testType, isZeroBad, dbuf, &nAvgA, &nAvgB);
+                    switch (tail){
+                        case TAIL_ONE_MINUS:
+                            count += (z <= z0);
+                            if (z < tmax[ip]) tmax[ip] = z;
+                            break;
+                        case TAIL_ONE_PLUS:
+                            count += (z >= z0);
+                            if (z > tmax[ip]) tmax[ip] = z;
+                            break;
+                        case TAIL_TWO:
+                            count += (fabs(z) >= fabs(z0));
+                            if (fabs(z) > tmax[ip]) tmax[ip] = fabs(z);
+                            break;
+                    }
+                    if (PS){
+                        PS[ip + (size_t) j * nPerm] = (float) z;
+                    }
+                }
+                S[j] = count;
+            }
+        }
+        mxFree(colBuf);
+    }
+
+    /* Reduce the max-statistic distributions of all the threads */
+    for (i=0; i<nPerm; i++){
+        double m = maxThread[i];
+        int t;
+        for (t=1; t<nThreads; t++){
+            double v = maxThread[(size_t) t * nPerm + i];
+            if ((tail == TAIL_ONE_MINUS) ? (v < m) : (v > m)){
+                m = v;
+            }
+        }
+        maxS[i] = m;
+    }
+
+    mxFree(maxThread);
+    mxFree(iRef);
+    mxFree(perm);
+} /* end mexFunction() */
@@ -0,0 +1,44 @@
+function varargout = bst_permtest_mex(varargin)
+%BST_PERMTEST_MEX: Mex-file to evaluate all the permutations of bst_permtest in one pass (t-tests and absmean)
+%
+% USAGE: [S, S0, nGoodA, nGoodB, maxS, PS] = bst_permtest_mex(X, P, nA, TestType, tails, isZeroBad)
+% 
+% INPUTS: 
+%    - X         : [nA+nB x N] double or single matrix, samples A followed by samples B
+%    - P         : [nPerm x nA+nB] matrix of row indices in X: P(i,1:nA)=group A, P(i,nA+1:end)=group B
+%    - nA        : Number of samples in group A
+%    - TestType  : {'ttest_equal', 'ttest_unequal', 'ttest_paired', 'absmean'}
+%    - tails     : {'one-', 'one+', 'two'}
+%    - isZeroBad : If 1, excludes all the zero values from the computation
+%
+% OUTPUTS:
+%    - S      : [1xN] number of permutations for which the statistic exceeds the observed statistic
+%    - S0     : [1xN] observed statistic
+%    - nGoodA : [1xN] number of non-zero values in A (paired tests: in A-B)
+%    - nGoodB : [1xN] number of non-zero values in B (empty for paired tests)
+%    - maxS   : [nPerm x 1] max-statistic null distribution
+%    - PS     : [nPerm x N] single matrix with all the permutation statistics
+% 
+% COMPILE:
+%    mex -v bst_permtest_mex.c
+%    Multithreaded (Linux): mex -v CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" bst_permtest_mex.c
+
+% @=============================================================================
+% This function is part of the Brainstorm software:
+% https://neuroimage.usc.edu/brainstorm
+% 
+% Copyright (c) University of Southern California & McGill University
+% This software is distributed under the terms of the GNU General Public License
+% as published by the Free Software Foundation. Further details on the GPLv3
+% license can be found at http://www.gnu.org/copyleft/gpl.html.
+% 
+% FOR RESEARCH PURPOSES ONLY. THE SOFTWARE IS PROVIDED "AS IS," AND THE
+% UNIVERSITY OF SOUTHERN CALIFORNIA AND ITS COLLABORATORS DO NOT MAKE ANY
+% WARRANTY, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO WARRANTIES OF
+% MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, NOR DO THEY ASSUME ANY
+% LIABILITY OR RESPONSIBILITY FOR THE USE OF THIS SOFTWARE.
+%
+% For more information type "brainstorm license" at command prompt.
+% =============================================================================@
+
+error('Mex-function bst_permtest_mex.c not compiled.');
@@ -0,0 +1,144 @@
+/*--------------------------------------------------------------
+ * file: mex.h - Minimal replacement of the Matlab MEX API, to run the MEX files without Matlab
+ *
+ * Only the functions used by the Brainstorm MEX files are declared. Their behavior follows the
+ * documentation of the Matlab MEX API compiled with -R2018a (interleaved complex arrays):
+ *  - numeric arrays are column-major, complex values are interleaved (real, imaginary),
+ *  - mexErrMsgTxt and mexErrMsgIdAndTxt print the message and exit the program,
+ *  - all the memory allocated by mxMalloc/mxCalloc/mxRealloc is counted, to report the peak memory,
+ *    it is not released automatically at the end of the calls (the few temporary strings and
+ *    buffers that the MEX files leave to Matlab to release are lost),
+ *  - the functions registered with mexAtExit are called by mexshim_clear() ("clear mex").
+ * mexCallMATLAB only supports "datenum" (used by readPLXFileC).
+ *
+ * See mexbench.c for the compilation of the MEX files with this header.
+ *-------------------------------------------------------------- */
+#ifndef MEXBENCH_MEX_H
+#define MEXBENCH_MEX_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef MX_HAS_INTERLEAVED_COMPLEX
+#define MX_HAS_INTERLEAVED_COMPLEX 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ===== TYPES ===== */
+typedef size_t mwSize;
+typedef size_t mwIndex;
+typedef ptrdiff_t mwSignedIndex;
+typedef bool mxLogical;
+typedef char mxChar;
+typedef struct mxArray_tag mxArray;
+/* Fixed-size integers of tmwtypes.h */
+typedef int8_t   INT8_T;
+typedef uint8_t  UINT8_T;
+typedef int16_t  INT16_T;
+typedef uint16_t UINT16_T;
+typedef int32_t  INT32_T;
+typedef uint32_t UINT32_T;
+typedef int64_t  INT64_T;
+typedef uint64_t UINT64_T;
+
+typedef enum {
+    mxUNKNOWN_CLASS = 0, mxCELL_CLASS, mxSTRUCT_CLASS, mxLOGICAL_CLASS, mxCHAR_CLASS, mxVOID_CLASS,
+    mxDOUBLE_CLASS, mxSINGLE_CLASS, mxINT8_CLASS, mxUINT8_CLASS, mxINT16_CLASS, mxUINT16_CLASS,
+    mxINT32_CLASS, mxUINT32_CLASS, mxINT64_CLASS, mxUINT64_CLASS, mxFUNCTION_CLASS
+} mxClassID;
+
+typedef enum { mxREAL = 0, mxCOMPLEX } mxComplexity;
+
+typedef struct { double real, imag; } mxComplexDouble;
+typedef struct { float  real, imag; } mxComplexSingle;
+
+/* ===== MEMORY ===== */
+void *mxMalloc(size_t n);
+void *mxCalloc(size_t n, size_t size);
+void *mxRealloc(void *ptr, size_t n);
+void  mxFree(void *ptr);
+void  mexMakeMemoryPersistent(void *ptr);
+void  mexMakeArrayPersistent(mxArray *pa);
+
+/* ===== ARRAY CREATION ===== */
+mxArray *mxCreateNumericArray(mwSize ndim, const mwSize *dims, mxClassID classid, mxComplexity flag);
+mxArray *mxCreateNumericMatrix(mwSize m, mwSize n, mxClassID classid, mxComplexity flag);
+mxArray *mxCreateDoubleMatrix(mwSize m, mwSize n, mxComplexity flag);
+mxArray *mxCreateDoubleScalar(double value);
+mxArray *mxCreateLogicalScalar(bool value);
+mxArray *mxCreateString(const char *str);
+mxArray *mxCreateStructMatrix(mwSize m, mwSize n, int nfields, const char **fieldnames);
+mxArray *mxDuplicateArray(const mxArray *pa);
+void     mxDestroyArray(mxArray *pa);
+
+/* ===== ARRAY PROPERTIES ===== */
+mxClassID     mxGetClassID(const mxArray *pa);
+bool          mxIsClass(const mxArray *pa, const char *name);
+bool          mxIsDouble(const mxArray *pa);
+bool          mxIsSingle(const mxArray *pa);
+bool          mxIsNumeric(const mxArray *pa);
+bool          mxIsComplex(const mxArray *pa);
+bool          mxIsChar(const mxArray *pa);
+bool          mxIsStruct(const mxArray *pa);
+bool          mxIsLogical(const mxArray *pa);
+bool          mxIsLogicalScalar(const mxArray *pa);
+bool          mxIsLogicalScalarTrue(const mxArray *pa);
+bool          mxIsEmpty(const mxArray *pa);
+size_t        mxGetM(const mxArray *pa);
+size_t        mxGetN(const mxArray *pa);
+void          mxSetM(mxArray *pa, mwSize m);
+void          mxSetN(mxArray *pa, mwSize n);
+size_t        mxGetNumberOfElements(const mxArray *pa);
+mwSize        mxGetNumberOfDimensions(const mxArray *pa);
+const mwSize *mxGetDimensions(const mxArray *pa);
+int           mxSetDimensions(mxArray *pa, const mwSize *dims, mwSize ndim);
+
+/* ===== DATA ACCESS ===== */
+double          *mxGetPr(const mxArray *pa);
+double          *mxGetPi(const mxArray *pa);
+void            *mxGetData(const mxArray *pa);
+void             mxSetData(mxArray *pa, void *data);
+mxComplexDouble *mxGetComplexDoubles(const mxArray *pa);
+mxComplexSingle *mxGetComplexSingles(const mxArray *pa);
+double           mxGetScalar(const mxArray *pa);
+char            *mxArrayToString(const mxArray *pa);
+int              mxGetString(const mxArray *pa, char *buf, mwSize buflen);
+
+/* ===== STRUCTURES ===== */
+mxArray *mxGetField(const mxArray *pa, mwIndex i, const char *fieldname);
+mxArray *mxGetFieldByNumber(const mxArray *pa, mwIndex i, int fieldnumber);
+const char *mxGetFieldNameByNumber(const mxArray *pa, int fieldnumber);
+int      mxGetNumberOfFields(const mxArray *pa);
+void     mxSetField(mxArray *pa, mwIndex i, const char *fieldname, mxArray *value);
+int      mxGetFieldNumber(const mxArray *pa, const char *fieldname);
+int      mxAddField(mxArray *pa, const char *fieldname);
+void     mxRemoveField(mxArray *pa, int fieldnumber);
+
+/* ===== MEX FUNCTIONS ===== */
+void mexErrMsgTxt(const char *msg);
+void mexErrMsgIdAndTxt(const char *id, const char *fmt, ...);
+void mexWarnMsgTxt(const char *msg);
+void mexWarnMsgIdAndTxt(const char *id, const char *fmt, ...);
+int  mexPrintf(const char *fmt, ...);
+int  mexAtExit(void (*fcn)(void));
+int  mexCallMATLAB(int nlhs, mxArray *plhs[], int nrhs, mxArray *prhs[], const char *fcn);
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+
+/* ===== BENCHMARK FUNCTIONS (not part of the MEX API) ===== */
+size_t mexshim_current_bytes(void);     /* Memory currently allocated with mxMalloc */
+size_t mexshim_peak_bytes(void);        /* Maximum of the allocated memory since the last reset */
+void   mexshim_reset_peak(void);        /* Reset the peak to the current allocated memory */
+void   mexshim_clear(void);             /* Call the functions registered with mexAtExit ("clear mex") */
+int    mexshim_quiet(int isQuiet);      /* Hide the output of mexPrintf/warnings, returns previous state */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
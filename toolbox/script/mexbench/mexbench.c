@@ -0,0 +1,1213 @@
+/*--------------------------------------------------------------
+ * file: mexbench.c - Benchmarks of the Brainstorm MEX files, without Matlab (Linux)
+ *
+ * USAGE:  mexbench <benchmark> [--option value ...]
+ *         mexbench compare <old.csv> <new.csv> [--tolerance 0.10]
+ *         mexbench help
+ *
+ * BENCHMARKS:
+ *    - meanvar   : bst_meanvar on a [rows x cols] matrix, for all the supported classes
+ *    - pac       : direct_pac_mex (computeDirectPAC) on [signals x time x nlow] phases and [signals x time x nhigh] amplitudes
+ *    - plx       : readPLXFileC on a synthetic PLX file: tally, block index, fragments, dense, random windows, streaming
+ *    - permtest  : bst_permtest_mex, independent and paired t-tests
+ *    - fftfilt   : bst_fftfilt, entire signals and by chunks
+ *    - morlet    : morlet_transform_mex, first call (spectra of the wavelets computed), next calls, trials
+ *    - xspectrum : xspectrum_mex, all-to-all cross-spectra
+ *    - all       : all of the above
+ *
+ * COMMON OPTIONS:
+ *    --repeat N  : Number of executions of each phase (default: 3), the minimum and median times are reported
+ *    --threads N : Number of OpenMP threads (default: all the cores)
+ *    --csv FILE  : Append the results to a CSV file, to compare builds with "mexbench compare"
+ *    --seed N    : Seed of the random inputs (default: 1)
+ * The sizes of the inputs are set with the options listed by "mexbench help".
+ *
+ * For each phase: minimum and median execution time, throughput of the input data (GB/s), rate in the units
+ * of the benchmark, peak of the memory allocated by the MEX file during the call (outputs included) and a
+ * checksum of the outputs. The maximum resident memory of the process is printed at the end.
+ * "compare" lists the phases of new.csv that are slower than in old.csv by more than the tolerance, or whose
+ * checksum changed, and returns 1 if there is any: it detects the regressions after recompiling the MEX files
+ * with a different compiler or different flags (both runs must use the same options, the checksums depend on the
+ * sizes and the seed). When a CSV file contains several runs, the last one is used.
+ *
+ * The MEX files are compiled with the replacement mex.h of this folder, each with its mexFunction renamed
+ * mexFunction_<name> so that they can be linked in the same program (see Makefile).
+ * The PLX file is read from the page cache after it is generated: the times do not include the disk accesses.
+ * The plx benchmark also checks the first sample of windows and streams read at Fs = ADFrequency, with the start times
+ * computed from the sample indices as in in_fread_plexon.m, and the chunk where the streams end: mexbench returns 1 if
+ * a check fails.
+ *-------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "mex.h"
+#include "PlexonFiles.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef MEXBENCH_CFLAGS
+#define MEXBENCH_CFLAGS "unknown"
+#endif
+#ifdef __VERSION__
+#define MEXBENCH_COMPILER __VERSION__
+#else
+#define MEXBENCH_COMPILER "unknown"
+#endif
+
+/* Maximum number of executions of a phase */
+#define MB_MAXREPEAT 100
+/* Maximum number of rows read from a CSV file */
+#define MB_MAXROWS 1000
+/* Relative difference above which two checksums are considered different */
+#define MB_CHECKSUM_TOL 1e-6
+
+/* MEX files, compiled with -DmexFunction=mexFunction_<name> */
+typedef void (*mex_fcn)(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+void mexFunction_bst_meanvar(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+void mexFunction_direct_pac_mex(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+void mexFunction_readPLXFileC(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+void mexFunction_bst_permtest_mex(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+void mexFunction_bst_fftfilt(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+void mexFunction_morlet_transform_mex(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+void mexFunction_xspectrum_mex(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+
+/* Function executed by a phase: returns the checksum of the outputs */
+typedef double (*phase_fcn)(void *ctx);
+
+/* Result of a phase, one row of the CSV file */
+typedef struct {
+    char   bench[32];
+    char   phase[32];
+    int    threads;
+    int    repeat;
+    double tmin;        /* Minimum time (s) */
+    double tmed;        /* Median time (s) */
+    double gbps;        /* Input data processed per second (GB/s) */
+    double rate;        /* Units processed per second */
+    char   unit[32];
+    double peakMB;      /* Peak of the memory allocated during the call (MB) */
+    double checksum;    /* Sum of all the values of the outputs */
+} bench_result;
+
+static int    gArgc;
+static char **gArgv;
+static int   *gArgUsed;
+static int    nRepeat = 3;
+static FILE  *fidCsv  = NULL;
+static unsigned long long rngSeed  = 1;
+static unsigned long long rngState = 1;
+static int    nFailed  = 0;     /* Number of failed checks */
+
+
+/* ===== COMMAND LINE ===== */
+/* Value of option --name, or default value */
+static const char *opt_str(const char *name, const char *def){
+    int i;
+    for (i = 2; i < gArgc - 1; i++){
+        if ((strncmp(gArgv[i], "--", 2) == 0) && (strcmp(gArgv[i] + 2, name) == 0)){
+            gArgUsed[i] = 1;
+            gArgUsed[i+1] = 1;
+            return gArgv[i+1];
+        }
+    }
+    return def;
+}
+static double opt_num(const char *name, double def){
+    const char *str = opt_str(name, NULL);
+    char *end;
+    double val;
+    if (str == NULL) return def;
+    val = strtod(str, &end);
+    if ((*end != 0) || (end == str)){
+        fprintf(stderr, "Error: Invalid value for option --%s: %s\n", name, str);
+        exit(2);
+    }
+    return val;
+}
+static size_t opt_size(const char *name, size_t def){
+    double val = opt_num(name, (double) def);
+    if ((val < 1) || (val != floor(val))){
+        fprintf(stderr, "Error: Option --%s must be a positive integer.\n", name);
+        exit(2);
+    }
+    return (size_t) val;
+}
+
+
+/* ===== UTILITIES ===== */
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+/* Random numbers: xorshift64* */
+static double rnd_uniform(void){
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return ((rngState * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+/* Random numbers of a benchmark: do not depend on the options of the other benchmarks */
+static void rnd_init(const char *bench){
+    rngState = rngSeed * 0x9E3779B97F4A7C15ULL;
+    while (*bench){
+        rngState = (rngState ^ (unsigned char) *bench++) * 0x100000001B3ULL;
+    }
+    if (rngState == 0) rngState = 1;
+}
+static double rnd_normal(void){
+    double u = rnd_uniform() + 1e-300;
+    return sqrt(-2 * log(u)) * cos(6.283185307179586 * rnd_uniform());
+}
+static int cmp_double(const void *a, const void *b){
+    double d = *(const double*) a - *(const double*) b;
+    return (d > 0) - (d < 0);
+}
+static int get_threads(void){
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+static const char *class_name(mxClassID classid){
+    switch (classid){
+        case mxDOUBLE_CLASS: return "double";
+        case mxSINGLE_CLASS: return "single";
+        case mxINT16_CLASS:  return "int16";
+        case mxINT32_CLASS:  return "int32";
+        default:             return "other";
+    }
+}
+static size_t class_bytes(mxClassID classid){
+    return ((classid == mxDOUBLE_CLASS) ? 8 : (classid == mxINT16_CLASS) ? 2 : 4);
+}
+
+/* Sum of all the numeric values of an array (recursively for structures) */
+static double checksum_array(const mxArray *pa){
+    size_t n, i;
+    double s = 0;
+    int k;
+    if (pa == NULL) return 0;
+    if (mxIsStruct(pa)){
+        for (i = 0; i < mxGetNumberOfElements(pa); i++){
+            for (k = 0; k < mxGetNumberOfFields(pa); k++){
+                s += checksum_array(mxGetFieldByNumber(pa, i, k));
+            }
+        }
+        return s;
+    }
+    n = mxGetNumberOfElements(pa) * (mxIsComplex(pa) ? 2 : 1);
+    switch (mxGetClassID(pa)){
+        case mxDOUBLE_CLASS:  { const double    *x = (const double*)    mxGetData(pa); for (i = 0; i < n; i++) s += x[i]; break; }
+        case mxSINGLE_CLASS:  { const float     *x = (const float*)     mxGetData(pa); for (i = 0; i < n; i++) s += x[i]; break; }
+        case mxINT8_CLASS:    { const int8_t    *x = (const int8_t*)    mxGetData(pa); for (i = 0; i < n; i++) s += x[i]; break; }
+        case mxUINT8_CLASS:   { const uint8_t   *x = (const uint8_t*)   mxGetData(pa); for (i = 0; i < n; i++) s += x[i]; break; }
+        case mxINT16_CLASS:   { const int16_t   *x = (const int16_t*)   mxGetData(pa); for (i = 0; i < n; i++) s += x[i]; break; }
+        case mxUINT16_CLASS:  { const uint16_t  *x = (const uint16_t*)  mxGetData(pa); for (i = 0; i < n; i++) s += x[i]; break; }
+        case mxINT32_CLASS:   { const int32_t   *x = (const int32_t*)   mxGetData(pa); for (i = 0; i < n; i++) s += x[i]; break; }
+        case mxUINT32_CLASS:  { const uint32_t  *x = (const uint32_t*)  mxGetData(pa); for (i = 0; i < n; i++) s += x[i]; break; }
+        case mxINT64_CLASS:   { const int64_t   *x = (const int64_t*)   mxGetData(pa); for (i = 0; i < n; i++) s += (double) x[i]; break; }
+        case mxUINT64_CLASS:  { const uint64_t  *x = (const uint64_t*)  mxGetData(pa); for (i = 0; i < n; i++) s += (double) x[i]; break; }
+        case mxLOGICAL_CLASS: { const mxLogical *x = (const mxLogical*) mxGetData(pa); for (i = 0; i < n; i++) s += x[i]; break; }
+        default: break;
+    }
+    return s;
+}
+
+/* Call a MEX file, return the checksum of the outputs and delete them */
+static double call_mex(mex_fcn fcn, int nlhs, int nrhs, const mxArray *prhs[]){
+    mxArray *plhs[8] = {NULL};
+    double s = 0;
+    int i;
+    fcn(nlhs, plhs, nrhs, prhs);
+    for (i = 0; i < 8; i++){
+        s += checksum_array(plhs[i]);
+        mxDestroyArray(plhs[i]);
+    }
+    return s;
+}
+
+/* Random matrix: normal values (x scale) for double/single, uniform integers in [-scale,scale] for int16/int32 */
+static mxArray *random_array(mwSize ndim, const mwSize *dims, mxClassID classid, mxComplexity flag, double scale){
+    mxArray *pa = mxCreateNumericArray(ndim, dims, classid, flag);
+    size_t n = mxGetNumberOfElements(pa) * ((flag == mxCOMPLEX) ? 2 : 1), i;
+    void *x = mxGetData(pa);
+    for (i = 0; i < n; i++){
+        switch (classid){
+            case mxDOUBLE_CLASS: ((double*)  x)[i] = scale * rnd_normal(); break;
+            case mxSINGLE_CLASS: ((float*)   x)[i] = (float) (scale * rnd_normal()); break;
+            case mxINT16_CLASS:  ((int16_t*) x)[i] = (int16_t) floor((2 * scale + 1) * rnd_uniform() - scale); break;
+            case mxINT32_CLASS:  ((int32_t*) x)[i] = (int32_t) floor((2 * scale + 1) * rnd_uniform() - scale); break;
+            default: break;
+        }
+    }
+    return pa;
+}
+
+
+/* ===== EXECUTION OF THE PHASES ===== */
+/*
+ * Execute a phase nRepeat times and report the results
+ * bytes     : Number of bytes of input data processed by one execution
+ * units     : Number of units processed by one execution (unit: name of the rate)
+ * isCold    : If 1, the caches of the MEX files are cleared before each execution (not timed)
+ */
+static void run_phase(const char *bench, const char *phase, phase_fcn fcn, void *ctx,
+                      double bytes, double units, const char *unit, int isCold){
+    double t[MB_MAXREPEAT], t0, checksum = 0;
+    size_t base, peak = 0;
+    bench_result r;
+    int i;
+
+    for (i = 0; i < nRepeat; i++){
+        if (isCold){
+            mexshim_clear();
+        }
+        base = mexshim_current_bytes();
+        mexshim_reset_peak();
+        t0 = now();
+        checksum = fcn(ctx);
+        t[i] = now() - t0;
+        if (mexshim_peak_bytes() - base > peak){
+            peak = mexshim_peak_bytes() - base;
+        }
+    }
+    qsort(t, nRepeat, sizeof(double), cmp_double);
+
+    memset(&r, 0, sizeof(r));
+    strncpy(r.bench, bench, sizeof(r.bench) - 1);
+    strncpy(r.phase, phase, sizeof(r.phase) - 1);
+    strncpy(r.unit, unit, sizeof(r.unit) - 1);
+    r.threads  = get_threads();
+    r.repeat   = nRepeat;
+    r.tmin     = t[0];
+    r.tmed     = (nRepeat % 2) ? t[nRepeat / 2] : 0.5 * (t[nRepeat / 2 - 1] + t[nRepeat / 2]);
+    r.gbps     = (r.tmin > 0) ? bytes / r.tmin / 1e9 : 0;
+    r.rate     = (r.tmin > 0) ? units / r.tmin : 0;
+    r.peakMB   = peak / 1048576.0;
+    r.checksum = checksum;
+
+    printf("%-10s %-14s %10.4f %10.4f %8.3f %12.4g %-10s %10.1f  %.12g\n",
+           r.bench, r.phase, r.tmin, r.tmed, r.gbps, r.rate, r.unit, r.peakMB, r.checksum);
+    fflush(stdout);
+    if (fidCsv != NULL){
+        fprintf(fidCsv, "%s,%s,%d,%d,%.6g,%.6g,%.6g,%.6g,%s,%.6g,%.17g\n",
+                r.bench, r.phase, r.threads, r.repeat, r.tmin, r.tmed, r.gbps, r.rate, r.unit, r.peakMB, r.checksum);
+        fflush(fidCsv);
+    }
+}
+
+/* Phase with a single call to a MEX file */
+typedef struct {
+    mex_fcn fcn;
+    int nlhs;
+    int nrhs;
+    const mxArray *prhs[8];
+} call_ctx;
+
+static double phase_call(void *ctx){
+    call_ctx *c = (call_ctx*) ctx;
+    return call_mex(c->fcn, c->nlhs, c->nrhs, c->prhs);
+}
+
+
+/* ===== MEANVAR ===== */
+static void bench_meanvar(void){
+    static const mxClassID classes[4] = {mxDOUBLE_CLASS, mxSINGLE_CLASS, mxINT16_CLASS, mxINT32_CLASS};
+    size_t nRows = opt_size("rows", 200);
+    size_t nCols = opt_size("cols", 100000);
+    mxArray *x, *isZeroBad;
+    call_ctx c;
+    char phase[32];
+    int i;
+
+    for (i = 0; i < 5; i++){
+        mxClassID classid = classes[(i < 4) ? i : 1];
+        mwSize dims[2];
+        dims[0] = nRows;
+        dims[1] = nCols;
+        x = random_array(2, dims, classid, mxREAL, (classid == mxINT16_CLASS) ? 1000 : (classid == mxINT32_CLASS) ? 100000 : 1);
+        isZeroBad = mxCreateDoubleScalar(i == 4);
+        /* Zero bad: 10% of the values set to zero */
+        if (i == 4){
+            float *xf = (float*) mxGetData(x);
+            size_t k;
+            for (k = 0; k < nRows * nCols; k++){
+                if (rnd_uniform() < 0.1) xf[k] = 0;
+            }
+        }
+        memset(&c, 0, sizeof(c));
+        c.fcn     = mexFunction_bst_meanvar;
+        c.nlhs    = 3;
+        c.nrhs    = 2;
+        c.prhs[0] = x;
+        c.prhs[1] = isZeroBad;
+        snprintf(phase, sizeof(phase), "%s%s", class_name(classid), (i == 4) ? "-zerobad" : "");
+        run_phase("meanvar", phase, phase_call, &c, (double) nRows * nCols * class_bytes(classid), (double) nRows * nCols, "values/s", 0);
+        mxDestroyArray(x);
+        mxDestroyArray(isZeroBad);
+    }
+}
+
+
+/* ===== DIRECT PAC ===== */
+static void bench_pac(void){
+    size_t nSig  = opt_size("signals", 16);
+    size_t nTime = opt_size("time", 10000);
+    size_t nLow  = opt_size("nlow", 20);
+    size_t nHigh = opt_size("nhigh", 30);
+    mxArray *phase, *amp;
+    mxComplexDouble *ph;
+    double *a;
+    mwSize dims[3];
+    call_ctx c;
+    size_t i;
+
+    /* Phases: unit complex numbers, amplitudes: positive values */
+    dims[0] = nSig;
+    dims[1] = nTime;
+    dims[2] = nLow;
+    phase = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxCOMPLEX);
+    ph = mxGetComplexDoubles(phase);
+    for (i = 0; i < nSig * nTime * nLow; i++){
+        double theta = 6.283185307179586 * rnd_uniform();
+        ph[i].real = cos(theta);
+        ph[i].imag = sin(theta);
+    }
+    dims[2] = nHigh;
+    amp = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+    a = mxGetPr(amp);
+    for (i = 0; i < nSig * nTime * nHigh; i++){
+        a[i] = fabs(rnd_normal());
+    }
+
+    memset(&c, 0, sizeof(c));
+    c.fcn     = mexFunction_direct_pac_mex;
+    c.nlhs    = 1;
+    c.nrhs    = 2;
+    c.prhs[0] = phase;
+    c.prhs[1] = amp;
+    run_phase("pac", "compute", phase_call, &c, (double) nSig * nTime * (16.0 * nLow + 8.0 * nHigh),
+              (double) nSig * nLow * nHigh, "pairs/s", 0);
+    mxDestroyArray(phase);
+    mxDestroyArray(amp);
+}
+
+
+/* ===== PLX ===== */
+/* Write a PLX file: nChan continuous channels at Fs Hz (blocks of 256 samples), 4 spike channels and 2 event channels
+ * Sample #i of channel #c (from 0) is ((i*7 + c*100) % 2000) - 1000, plus a normal noise of standard deviation 'noise' */
+static int plx_generate(const char *filename, int nChan, int Fs, double duration, double noise){
+    const int ADFreq = 40000, nSpikeChan = 4, nEventChan = 2, blockSize = 256;
+    struct PL_FileHeader fh;
+    struct PL_ChanHeader ch;
+    struct PL_EventHeader eh;
+    struct PL_SlowChannelHeader sh;
+    struct PL_DataBlockHeader db;
+    long long nSamples = (long long) (duration * Fs), s0;
+    short buf[256];
+    FILE *fid;
+    int i, iChan, n;
+
+    fid = fopen(filename, "wb");
+    if (fid == NULL) return 1;
+    /* File header */
+    memset(&fh, 0, sizeof(fh));
+    fh.MagicNumber         = 0x58454c50;
+    fh.Version             = 107;
+    fh.ADFrequency         = ADFreq;
+    fh.NumDSPChannels      = nSpikeChan;
+    fh.NumEventChannels    = nEventChan;
+    fh.NumSlowChannels     = nChan;
+    fh.NumPointsWave       = 32;
+    fh.NumPointsPreThr     = 8;
+    fh.Year                = 2020;
+    fh.Month               = 1;
+    fh.Day                 = 2;
+    fh.WaveformFreq        = ADFreq;
+    fh.LastTimestamp       = (double) nSamples * ADFreq / Fs;
+    fh.Trodalness          = 1;
+    fh.DataTrodalness      = 1;
+    fh.BitsPerSpikeSample  = 12;
+    fh.BitsPerSlowSample   = 16;
+    fh.SpikeMaxMagnitudeMV = 3000;
+    fh.SlowMaxMagnitudeMV  = 5000;
+    fh.SpikePreAmpGain     = 1000;
+    fwrite(&fh, sizeof(fh), 1, fid);
+    /* Channel headers */
+    for (i = 0; i < nSpikeChan; i++){
+        memset(&ch, 0, sizeof(ch));
+        snprintf(ch.Name, sizeof(ch.Name), "sp%d", i + 1);
+        ch.Channel = i + 1;
+        ch.Gain = 1;
+        fwrite(&ch, sizeof(ch), 1, fid);
+    }
+    for (i = 0; i < nEventChan; i++){
+        memset(&eh, 0, sizeof(eh));
+        snprintf(eh.Name, sizeof(eh.Name), "ev%d", i + 1);
+        eh.Channel = i + 1;
+        fwrite(&eh, sizeof(eh), 1, fid);
+    }
+    for (i = 0; i < nChan; i++){
+        memset(&sh, 0, sizeof(sh));
+        snprintf(sh.Name, sizeof(sh.Name), "AD%02d", i);
+        sh.Channel    = i;
+        sh.ADFreq     = Fs;
+        sh.Gain       = 1 + i % 4;
+        sh.PreAmpGain = 1000;
+        sh.Enabled    = 1;
+        fwrite(&sh, sizeof(sh), 1, fid);
+    }
+    /* Data blocks: one block per continuous channel every 256 samples, interleaved with spikes and events */
+    for (s0 = 0; s0 < nSamples; s0 += blockSize){
+        unsigned long long ts = (unsigned long long) s0 * ADFreq / Fs;
+        n = (nSamples - s0 < blockSize) ? (int) (nSamples - s0) : blockSize;
+        for (iChan = 0; iChan < nChan; iChan++){
+            memset(&db, 0, sizeof(db));
+            db.Type                      = PL_ADDataType;
+            db.TimeStamp                 = (unsigned int) ts;
+            db.UpperByteOf5ByteTimestamp = (unsigned short) (ts >> 32);
+            db.Channel                   = iChan;
+            db.NumberOfWaveforms         = 1;
+            db.NumberOfWordsInWaveform   = n;
+            for (i = 0; i < n; i++){
+                buf[i] = (short) ((((s0 + i) * 7 + iChan * 100) % 2000) - 1000 + (int) (noise * rnd_normal()));
+            }
+            fwrite(&db, sizeof(db), 1, fid);
+            fwrite(buf, sizeof(short), n, fid);
+        }
+        if (rnd_uniform() < 0.3){
+            unsigned long long tsSpike = ts + (unsigned long long) (rnd_uniform() * blockSize * ADFreq / Fs);
+            memset(&db, 0, sizeof(db));
+            db.Type                      = PL_SingleWFType;
+            db.TimeStamp                 = (unsigned int) tsSpike;
+            db.UpperByteOf5ByteTimestamp = (unsigned short) (tsSpike >> 32);
+            db.Channel                   = 1 + (short) (rnd_uniform() * nSpikeChan);
+            db.Unit                      = (short) (rnd_uniform() * 3);
+            db.NumberOfWaveforms         = 1;
+            db.NumberOfWordsInWaveform   = 32;
+            for (i = 0; i < 32; i++){
+                buf[i] = (short) (500 * sin(i / 5.0) + 20 * rnd_normal());
+            }
+            fwrite(&db, sizeof(db), 1, fid);
+            fwrite(buf, sizeof(short), 32, fid);
+        }
+        if (rnd_uniform() < 0.05){
+            memset(&db, 0, sizeof(db));
+            db.Type                      = PL_ExtEventType;
+            db.TimeStamp                 = (unsigned int) ts;
+            db.UpperByteOf5ByteTimestamp = (unsigned short) (ts >> 32);
+            db.Channel                   = 1 + (short) (rnd_uniform() * nEventChan);
+            db.Unit                      = (short) (rnd_uniform() * 100);
+            fwrite(&db, sizeof(db), 1, fid);
+        }
+    }
+    return fclose(fid);
+}
+
+/* Walk through a PLX file: number of data blocks, size and duration */
+static int plx_info(const char *filename, double *nBlocks, double *fileSize, double *duration){
+    struct PL_FileHeader fh;
+    struct PL_DataBlockHeader db;
+    struct stat st;
+    FILE *fid;
+    long skip;
+
+    if (stat(filename, &st) != 0) return 1;
+    fid = fopen(filename, "rb");
+    if ((fid == NULL) || (fread(&fh, sizeof(fh), 1, fid) != 1) || (fh.MagicNumber != 0x58454c50)){
+        if (fid != NULL) fclose(fid);
+        return 1;
+    }
+    skip = fh.NumDSPChannels * (long) sizeof(struct PL_ChanHeader) + fh.NumEventChannels * (long) sizeof(struct PL_EventHeader)
+         + fh.NumSlowChannels * (long) sizeof(struct PL_SlowChannelHeader);
+    fseek(fid, skip, SEEK_CUR);
+    *nBlocks = 0;
+    while (fread(&db, sizeof(db), 1, fid) == 1){
+        *nBlocks += 1;
+        if (fseek(fid, (long) db.NumberOfWaveforms * db.NumberOfWordsInWaveform * (long) sizeof(short), SEEK_CUR) != 0) break;
+    }
+    fclose(fid);
+    *fileSize = (double) st.st_size;
+    *duration = fh.LastTimestamp / fh.ADFrequency;
+    return 0;
+}
+
+/* Random time windows of 1s, read from the block index */
+typedef struct {
+    mxArray *filename;
+    int nWindows;
+    double duration;
+    unsigned long long seed;    /* Same windows at each execution */
+} plx_windows_ctx;
+
+static double phase_plx_windows(void *ctx){
+    plx_windows_ctx *c = (plx_windows_ctx*) ctx;
+    const mxArray *prhs[6];
+    unsigned long long prevState = rngState;
+    double s = 0, t;
+    int i;
+    rngState = c->seed;
+    prhs[0] = c->filename;
+    prhs[1] = mxCreateString("scaled");
+    prhs[2] = mxCreateString("start");
+    prhs[4] = mxCreateString("stop");
+    for (i = 0; i < c->nWindows; i++){
+        t = floor(rnd_uniform() * (c->duration - 1) * 1000) / 1000;
+        prhs[3] = mxCreateDoubleScalar(t);
+        prhs[5] = mxCreateDoubleScalar(t + 1);
+        s += call_mex(mexFunction_readPLXFileC, 1, 6, prhs);
+        mxDestroyArray((mxArray*) prhs[3]);
+        mxDestroyArray((mxArray*) prhs[5]);
+    }
+    mxDestroyArray((mxArray*) prhs[1]);
+    mxDestroyArray((mxArray*) prhs[2]);
+    mxDestroyArray((mxArray*) prhs[4]);
+    rngState = prevState;
+    return s;
+}
+
+/* Entire file read by chunks with a stream */
+typedef struct {
+    mxArray *filename;
+    double chunk;
+    int nChunks;
+} plx_stream_ctx;
+
+static double phase_plx_stream(void *ctx){
+    plx_stream_ctx *c = (plx_stream_ctx*) ctx;
+    const mxArray *prhs[3];
+    mxArray *plhs[1] = {NULL}, *handle, *streamEnd;
+    double s = 0;
+    int isEnd = 0;
+    /* Open stream */
+    prhs[0] = c->filename;
+    prhs[1] = mxCreateString("open");
+    prhs[2] = mxCreateString("scaled");
+    mexFunction_readPLXFileC(1, plhs, 3, prhs);
+    handle = mxDuplicateArray(mxGetField(plhs[0], 0, "Handle"));
+    mxDestroyArray(plhs[0]);
+    mxDestroyArray((mxArray*) prhs[1]);
+    mxDestroyArray((mxArray*) prhs[2]);
+    /* Read chunks */
+    prhs[0] = mxCreateString("read");
+    prhs[1] = handle;
+    prhs[2] = mxCreateDoubleScalar(c->chunk);
+    c->nChunks = 0;
+    while (!isEnd){
+        plhs[0] = NULL;
+        mexFunction_readPLXFileC(1, plhs, 3, prhs);
+        streamEnd = mxGetField(plhs[0], 0, "StreamEnd");
+        isEnd = (streamEnd == NULL) || (mxGetScalar(streamEnd) != 0);
+        s += checksum_array(mxGetField(plhs[0], 0, "ContinuousData"));
+        mxDestroyArray(plhs[0]);
+        c->nChunks++;
+    }
+    mxDestroyArray((mxArray*) prhs[0]);
+    mxDestroyArray((mxArray*) prhs[2]);
+    /* Close stream */
+    prhs[0] = mxCreateString("close");
+    mexFunction_readPLXFileC(0, plhs, 2, prhs);
+    mxDestroyArray((mxArray*) prhs[0]);
+    mxDestroyArray(handle);
+    return s;
+}
+
+/* Check the first sample of the dense matrix of a PLX structure: sample #k of the channel #0 of plx_generate */
+static int plx_check_first(const mxArray *plx, long long k){
+    const mxArray *data = mxGetField(plx, 0, "ContinuousData");
+    return (data != NULL) && (mxGetN(data) >= 1) && (((const int16_t*) mxGetData(data))[0] == (k * 7) % 2000 - 1000);
+}
+
+/* Windows and streams read at Fs = ADFrequency: start time computed from the sample index as in in_fread_plexon.m
+ * The streams must end (StreamEnd) with the chunk that contains the last sample of the file */
+static void plx_check_samples(const char *tmpdir){
+    const int Fs = 40000, nSamples = 2 * 40000, nWin = 100, nWindows = 2000, nStreams = 200;
+    const double chunk = 0.5;
+    const mxArray *prhs[6], *srhs[3];
+    mxArray *plhs[1], *streamEnd;
+    char filename[1024];
+    long long k;
+    int i, nChunks, isEnd, nShifted = 0, nShiftedStream = 0, nBadEnd = 0;
+
+    snprintf(filename, sizeof(filename), "%s/mexbench_%d_check.plx", tmpdir, (int) getpid());
+    if (plx_generate(filename, 1, Fs, (double) nSamples / Fs, 0) != 0){
+        fprintf(stderr, "Error: Cannot write file %s\n", filename);
+        exit(1);
+    }
+    /* Random access: readPLXFileC(filename, 'dense', 'start', t, 'stop', t + nWin/Fs) */
+    prhs[0] = mxCreateString(filename);
+    prhs[1] = mxCreateString("dense");
+    prhs[2] = mxCreateString("start");
+    prhs[4] = mxCreateString("stop");
+    for (i = 0; i < nWindows; i++){
+        /* Samples from 1 in Matlab, from 0 here */
+        k = (long long) (rnd_uniform() * (nSamples - nWin));
+        prhs[3] = mxCreateDoubleScalar((double) k / Fs);
+        prhs[5] = mxCreateDoubleScalar((double) (k + nWin) / Fs);
+        plhs[0] = NULL;
+        mexFunction_readPLXFileC(1, plhs, 6, prhs);
+        nShifted += !plx_check_first(plhs[0], k);
+        mxDestroyArray(plhs[0]);
+        mxDestroyArray((mxArray*) prhs[3]);
+        mxDestroyArray((mxArray*) prhs[5]);
+    }
+    mxDestroyArray((mxArray*) prhs[1]);
+    mxDestroyArray((mxArray*) prhs[2]);
+    mxDestroyArray((mxArray*) prhs[4]);
+    /* Streams: readPLXFileC(filename, 'open', 'dense', 'start', t), then readPLXFileC('read', Handle, chunk) until StreamEnd */
+    for (i = 0; i < nStreams; i++){
+        k = (long long) (rnd_uniform() * (nSamples - nWin));
+        prhs[1] = mxCreateString("open");
+        prhs[2] = mxCreateString("dense");
+        prhs[3] = mxCreateString("start");
+        prhs[4] = mxCreateDoubleScalar((double) k / Fs);
+        plhs[0] = NULL;
+        mexFunction_readPLXFileC(1, plhs, 5, prhs);
+        srhs[0] = mxCreateString("read");
+        srhs[1] = mxDuplicateArray(mxGetField(plhs[0], 0, "Handle"));
+        srhs[2] = mxCreateDoubleScalar(chunk);
+        mxDestroyArray(plhs[0]);
+        mxDestroyArray((mxArray*) prhs[1]);
+        mxDestroyArray((mxArray*) prhs[2]);
+        mxDestroyArray((mxArray*) prhs[3]);
+        mxDestroyArray((mxArray*) prhs[4]);
+        for (nChunks = 0, isEnd = 0; !isEnd && (nChunks <= nSamples / (chunk * Fs) + 1); nChunks++){
+            plhs[0] = NULL;
+            mexFunction_readPLXFileC(1, plhs, 3, srhs);
+            if (nChunks == 0){
+                nShiftedStream += !plx_check_first(plhs[0], k);
+            }
+            streamEnd = mxGetField(plhs[0], 0, "StreamEnd");
+            isEnd = (streamEnd == NULL) || (mxGetScalar(streamEnd) != 0);
+            mxDestroyArray(plhs[0]);
+        }
+        nBadEnd += (nChunks != (int) ceil((nSamples - k) / (chunk * Fs)));
+        mxDestroyArray((mxArray*) srhs[0]);
+        mxDestroyArray((mxArray*) srhs[2]);
+        srhs[0] = mxCreateString("close");
+        mexFunction_readPLXFileC(0, plhs, 2, srhs);
+        mxDestroyArray((mxArray*) srhs[0]);
+        mxDestroyArray((mxArray*) srhs[1]);
+    }
+    mxDestroyArray((mxArray*) prhs[0]);
+    remove(filename);
+    printf("%-10s %-14s %d/%d windows and %d/%d streams at %d Hz start at the wrong sample, %d/%d streams end at the wrong chunk\n",
+           "plx", "check", nShifted, nWindows, nShiftedStream, nStreams, Fs, nBadEnd, nStreams);
+    fflush(stdout);
+    if (nShifted + nShiftedStream + nBadEnd > 0){
+        nFailed++;
+    }
+}
+
+static void bench_plx(void){
+    const char *file   = opt_str("file", NULL);
+    const char *tmpdir = opt_str("tmpdir", "/tmp");
+    int    nChan       = (int) opt_size("channels", 32);
+    int    Fs          = (int) opt_size("rate", 2000);
+    double duration    = opt_num("seconds", 600);
+    int    isKeep      = (opt_num("keep", 0) != 0);
+    plx_windows_ctx cw;
+    plx_stream_ctx cs;
+    double nBlocks, fileSize, t0;
+    char filename[1024];
+    call_ctx c;
+    int i, prevQuiet;
+    static const char *phases[5][3] = {
+        {"tally",      "fullread", "noindex"},     /* Sequential scan, counts only */
+        {"index-cold", "fullread", NULL},          /* Block index built at each call */
+        {"index-warm", "fullread", NULL},          /* Block index already in memory */
+        {"fragments",  "continuous", NULL},        /* Continuous channels as int16 fragments */
+        {"dense",      "scaled", NULL}};           /* Continuous channels as [nChannels x nTime] Volts */
+
+    /* Generate the synthetic file */
+    if (file == NULL){
+        snprintf(filename, sizeof(filename), "%s/mexbench_%d.plx", tmpdir, (int) getpid());
+        t0 = now();
+        if (plx_generate(filename, nChan, Fs, duration, 20) != 0){
+            fprintf(stderr, "Error: Cannot write file %s\n", filename);
+            exit(1);
+        }
+        printf("%-10s %-14s %10.4f   (%d channels, %d Hz, %g s)\n", "plx", "generate", now() - t0, nChan, Fs, duration);
+    } else {
+        snprintf(filename, sizeof(filename), "%s", file);
+    }
+    if (plx_info(filename, &nBlocks, &fileSize, &duration) != 0){
+        fprintf(stderr, "Error: Invalid PLX file %s\n", filename);
+        exit(1);
+    }
+    printf("%-10s %-14s %.0f blocks, %.1f MB, %.1f s\n", "plx", "file", nBlocks, fileSize / 1048576.0, duration);
+
+    memset(&c, 0, sizeof(c));
+    c.fcn     = mexFunction_readPLXFileC;
+    c.nlhs    = 1;
+    c.prhs[0] = mxCreateString(filename);
+    /* The calls of readPLXFileC print warnings for the empty units of the synthetic file */
+    prevQuiet = mexshim_quiet(1);
+    for (i = 0; i < 5; i++){
+        c.nrhs    = (phases[i][2] != NULL) ? 3 : 2;
+        c.prhs[1] = mxCreateString(phases[i][1]);
+        c.prhs[2] = (phases[i][2] != NULL) ? mxCreateString(phases[i][2]) : NULL;
+        run_phase("plx", phases[i][0], phase_call, &c, fileSize, nBlocks, "blocks/s", (i == 1));
+        mxDestroyArray((mxArray*) c.prhs[1]);
+        mxDestroyArray((mxArray*) c.prhs[2]);
+    }
+    /* Entire file: spikes, waveforms, events and continuous fragments */
+    c.nrhs    = 2;
+    c.prhs[1] = mxCreateString("all");
+    run_phase("plx", "all", phase_call, &c, fileSize, nBlocks, "blocks/s", 0);
+    mxDestroyArray((mxArray*) c.prhs[1]);
+    /* Random access: windows of 1s */
+    if (duration > 1){
+        cw.filename = (mxArray*) c.prhs[0];
+        cw.nWindows = (int) opt_size("windows", 200);
+        cw.duration = duration;
+        cw.seed     = rngState;
+        run_phase("plx", "windows", phase_plx_windows, &cw, fileSize / duration * cw.nWindows, cw.nWindows, "windows/s", 0);
+    }
+    /* Streaming by chunks */
+    cs.filename = (mxArray*) c.prhs[0];
+    cs.chunk    = opt_num("chunk", 10);
+    run_phase("plx", "stream", phase_plx_stream, &cs, fileSize, nBlocks, "blocks/s", 1);
+    /* Sample accuracy of the time windows */
+    plx_check_samples(tmpdir);
+    mexshim_quiet(prevQuiet);
+
+    mexshim_clear();
+    mxDestroyArray((mxArray*) c.prhs[0]);
+    if ((file == NULL) && !isKeep){
+        remove(filename);
+    } else if (file == NULL){
+        printf("%-10s %-14s %s\n", "plx", "kept", filename);
+    }
+}
+
+
+/* ===== PERMUTATION TESTS ===== */
+static void bench_permtest(void){
+    size_t nTests   = opt_size("tests", 20000);
+    size_t nSamples = opt_size("samples", 20);
+    size_t nPerm    = opt_size("perm", 1000);
+    size_t nRows    = 2 * nSamples, i, k;
+    mxArray *X, *P, *Ppaired, *nA, *type, *typePaired, *tails, *isZeroBad;
+    double *p, *pp;
+    mwSize dims[2];
+    call_ctx c;
+
+    dims[0] = nRows;
+    dims[1] = nTests;
+    X = random_array(2, dims, mxDOUBLE_CLASS, mxREAL, 1);
+    /* Independent tests: random permutations of the rows (Fisher-Yates) */
+    P = mxCreateDoubleMatrix(nPerm, nRows, mxREAL);
+    p = mxGetPr(P);
+    /* Paired tests: random exchanges of the two samples of each pair */
+    Ppaired = mxCreateDoubleMatrix(nPerm, nRows, mxREAL);
+    pp = mxGetPr(Ppaired);
+    for (i = 0; i < nPerm; i++){
+        for (k = 0; k < nRows; k++){
+            p[i + k * nPerm] = (double) (k + 1);
+        }
+        for (k = nRows - 1; k > 0; k--){
+            size_t j = (size_t) (rnd_uniform() * (k + 1));
+            double tmp = p[i + k * nPerm];
+            p[i + k * nPerm] = p[i + j * nPerm];
+            p[i + j * nPerm] = tmp;
+        }
+        for (k = 0; k < nSamples; k++){
+            int isSwap = (rnd_uniform() < 0.5);
+            pp[i + k * nPerm]              = (double) (isSwap ? k + nSamples + 1 : k + 1);
+            pp[i + (k + nSamples) * nPerm] = (double) (isSwap ? k + 1 : k + nSamples + 1);
+        }
+    }
+    nA         = mxCreateDoubleScalar((double) nSamples);
+    type       = mxCreateString("ttest_equal");
+    typePaired = mxCreateString("ttest_paired");
+    tails      = mxCreateString("two");
+    isZeroBad  = mxCreateDoubleScalar(0);
+
+    memset(&c, 0, sizeof(c));
+    c.fcn     = mexFunction_bst_permtest_mex;
+    c.nlhs    = 5;
+    c.nrhs    = 6;
+    c.prhs[0] = X;
+    c.prhs[1] = P;
+    c.prhs[2] = nA;
+    c.prhs[3] = type;
+    c.prhs[4] = tails;
+    c.prhs[5] = isZeroBad;
+    run_phase("permtest", "ttest_equal", phase_call, &c, (double) nRows * nTests * 8, (double) nPerm * nTests, "tests/s", 0);
+    c.prhs[1] = Ppaired;
+    c.prhs[3] = typePaired;
+    run_phase("permtest", "ttest_paired", phase_call, &c, (double) nRows * nTests * 8, (double) nPerm * nTests, "tests/s", 0);
+
+    mxDestroyArray(X);
+    mxDestroyArray(P);
+    mxDestroyArray(Ppaired);
+    mxDestroyArray(nA);
+    mxDestroyArray(type);
+    mxDestroyArray(typePaired);
+    mxDestroyArray(tails);
+    mxDestroyArray(isZeroBad);
+}
+
+
+/* ===== FFT FILTERING ===== */
+typedef struct {
+    mxArray **chunks;
+    int nChunks;
+    mxArray *b;
+} fftfilt_ctx;
+
+/* Signals filtered by chunks, the state of the filter is passed from one call to the next */
+static double phase_fftfilt_chunks(void *ctx){
+    fftfilt_ctx *c = (fftfilt_ctx*) ctx;
+    mxArray *plhs[2], *zi = NULL, *isLast;
+    const mxArray *prhs[4];
+    double s = 0;
+    int i;
+    for (i = 0; i < c->nChunks; i++){
+        isLast  = mxCreateDoubleScalar(i == c->nChunks - 1);
+        prhs[0] = c->chunks[i];
+        prhs[1] = c->b;
+        prhs[2] = (zi != NULL) ? zi : mxCreateDoubleMatrix(0, 0, mxREAL);
+        prhs[3] = isLast;
+        plhs[0] = NULL;
+        plhs[1] = NULL;
+        mexFunction_bst_fftfilt(2, plhs, 4, prhs);
+        s += checksum_array(plhs[0]);
+        mxDestroyArray(plhs[0]);
+        mxDestroyArray((mxArray*) prhs[2]);
+        mxDestroyArray(isLast);
+        zi = plhs[1];
+    }
+    mxDestroyArray(zi);
+    return s;
+}
+
+static void bench_fftfilt(void){
+    size_t nChan  = opt_size("channels", 64);
+    size_t nTime  = opt_size("time", 300000);
+    size_t nTaps  = opt_size("taps", 1001);
+    size_t nChunk = opt_size("chunk", 10000);
+    mxArray *x, *b;
+    double *pb, *px, *pc, fc = 0.1, m;
+    mwSize dims[2];
+    fftfilt_ctx cf;
+    call_ctx c;
+    size_t i, k, n;
+
+    dims[0] = nChan;
+    dims[1] = nTime;
+    x = random_array(2, dims, mxDOUBLE_CLASS, mxREAL, 1);
+    /* Low-pass filter: sinc with a Hamming window */
+    b = mxCreateDoubleMatrix(1, nTaps, mxREAL);
+    pb = mxGetPr(b);
+    for (i = 0; i < nTaps; i++){
+        m = i - (nTaps - 1) / 2.0;
+        pb[i] = ((m == 0) ? 2 * fc : sin(6.283185307179586 * fc * m) / (3.141592653589793 * m))
+              * (0.54 - 0.46 * cos(6.283185307179586 * i / ((nTaps > 1) ? nTaps - 1 : 1)));
+    }
+    memset(&c, 0, sizeof(c));
+    c.fcn     = mexFunction_bst_fftfilt;
+    c.nlhs    = 1;
+    c.nrhs    = 2;
+    c.prhs[0] = x;
+    c.prhs[1] = b;
+    run_phase("fftfilt", "whole", phase_call, &c, (double) nChan * nTime * 8, (double) nChan * nTime, "samples/s", 0);
+
+    /* Same signals split in chunks of nChunk samples */
+    cf.nChunks = (int) ((nTime + nChunk - 1) / nChunk);
+    cf.chunks  = (mxArray**) malloc(cf.nChunks * sizeof(mxArray*));
+    cf.b       = b;
+    px = mxGetPr(x);
+    for (i = 0; i < (size_t) cf.nChunks; i++){
+        n = (nTime - i * nChunk < nChunk) ? nTime - i * nChunk : nChunk;
+        cf.chunks[i] = mxCreateDoubleMatrix(nChan, n, mxREAL);
+        pc = mxGetPr(cf.chunks[i]);
+        for (k = 0; k < n * nChan; k++){
+            pc[k] = px[i * nChunk * nChan + k];
+        }
+    }
+    run_phase("fftfilt", "chunks", phase_fftfilt_chunks, &cf, (double) nChan * nTime * 8, (double) nChan * nTime, "samples/s", 0);
+    for (i = 0; i < (size_t) cf.nChunks; i++){
+        mxDestroyArray(cf.chunks[i]);
+    }
+    free(cf.chunks);
+    mxDestroyArray(x);
+    mxDestroyArray(b);
+    mexshim_clear();
+}
+
+
+/* ===== MORLET WAVELETS ===== */
+static void bench_morlet(void){
+    size_t nSig    = opt_size("signals", 32);
+    size_t nTime   = opt_size("time", 5000);
+    size_t nFreq   = opt_size("freqs", 40);
+    size_t nTrials = opt_size("trials", 10);
+    double Fs      = opt_num("fs", 1000);
+    mxArray *x, *xTrials, *f, *fs, *fc, *fwhm, *measure;
+    double *pf;
+    mwSize dims[3];
+    call_ctx c;
+    size_t i;
+
+    dims[0] = nSig;
+    dims[1] = nTime;
+    dims[2] = nTrials;
+    x       = random_array(2, dims, mxDOUBLE_CLASS, mxREAL, 1);
+    xTrials = random_array(3, dims, mxDOUBLE_CLASS, mxREAL, 1);
+    /* Frequencies: 2Hz to Fs/8, linear */
+    f  = mxCreateDoubleMatrix(1, nFreq, mxREAL);
+    pf = mxGetPr(f);
+    for (i = 0; i < nFreq; i++){
+        pf[i] = 2 + (Fs / 8 - 2) * i / ((nFreq > 1) ? nFreq - 1 : 1);
+    }
+    fs      = mxCreateDoubleScalar(Fs);
+    fc      = mxCreateDoubleScalar(1);
+    fwhm    = mxCreateDoubleScalar(3);
+    measure = mxCreateString("power");
+
+    memset(&c, 0, sizeof(c));
+    c.fcn     = mexFunction_morlet_transform_mex;
+    c.nlhs    = 1;
+    c.nrhs    = 6;
+    c.prhs[0] = x;
+    c.prhs[1] = fs;
+    c.prhs[2] = f;
+    c.prhs[3] = fc;
+    c.prhs[4] = fwhm;
+    c.prhs[5] = measure;
+    run_phase("morlet", "cold", phase_call, &c, (double) nSig * nTime * 8, (double) nSig * nTime * nFreq, "coefs/s", 1);
+    run_phase("morlet", "warm", phase_call, &c, (double) nSig * nTime * 8, (double) nSig * nTime * nFreq, "coefs/s", 0);
+    c.prhs[0] = xTrials;
+    run_phase("morlet", "trials", phase_call, &c, (double) nSig * nTime * nTrials * 8, (double) nSig * nTime * nFreq * nTrials, "coefs/s", 0);
+
+    mxDestroyArray(x);
+    mxDestroyArray(xTrials);
+    mxDestroyArray(f);
+    mxDestroyArray(fs);
+    mxDestroyArray(fc);
+    mxDestroyArray(fwhm);
+    mxDestroyArray(measure);
+    mexshim_clear();
+}
+
+
+/* ===== CROSS-SPECTRA ===== */
+static void bench_xspectrum(void){
+    size_t nSig  = opt_size("signals", 128);
+    size_t nFreq = opt_size("freqs", 200);
+    size_t nWin  = opt_size("windows", 50);
+    mxArray *F;
+    mwSize dims[3];
+    call_ctx c;
+
+    dims[0] = nSig;
+    dims[1] = nFreq;
+    dims[2] = nWin;
+    F = random_array(3, dims, mxDOUBLE_CLASS, mxCOMPLEX, 1);
+    memset(&c, 0, sizeof(c));
+    c.fcn     = mexFunction_xspectrum_mex;
+    c.nlhs    = 1;
+    c.nrhs    = 1;
+    c.prhs[0] = F;
+    run_phase("xspectrum", "compute", phase_call, &c, (double) nSig * nFreq * nWin * 16,
+              (double) nSig * (nSig + 1) / 2 * nFreq * nWin, "pairs/s", 0);
+    mxDestroyArray(F);
+}
+
+
+/* ===== COMPARISON OF TWO RUNS ===== */
+/* Read the rows of a CSV file written with --csv (the last run of each phase is kept) */
+static int read_csv(const char *filename, bench_result *rows){
+    char line[1024];
+    bench_result r;
+    FILE *fid;
+    int nRows = 0, i;
+
+    fid = fopen(filename, "r");
+    if (fid == NULL){
+        fprintf(stderr, "Error: Cannot open file %s\n", filename);
+        exit(2);
+    }
+    while (fgets(line, sizeof(line), fid) != NULL){
+        if ((line[0] == '#') || (strncmp(line, "bench,", 6) == 0)) continue;
+        memset(&r, 0, sizeof(r));
+        if (sscanf(line, "%31[^,],%31[^,],%d,%d,%lf,%lf,%lf,%lf,%31[^,],%lf,%lf",
+                   r.bench, r.phase, &r.threads, &r.repeat, &r.tmin, &r.tmed, &r.gbps, &r.rate, r.unit, &r.peakMB, &r.checksum) != 11) continue;
+        for (i = 0; i < nRows; i++){
+            if ((strcmp(rows[i].bench, r.bench) == 0) && (strcmp(rows[i].phase, r.phase) == 0)) break;
+        }
+        if (i < MB_MAXROWS){
+            rows[i] = r;
+            if (i == nRows) nRows++;
+        }
+    }
+    fclose(fid);
+    return nRows;
+}
+
+static int compare_runs(const char *fileOld, const char *fileNew, double tol){
+    static bench_result rowsOld[MB_MAXROWS], rowsNew[MB_MAXROWS];
+    int nOld = read_csv(fileOld, rowsOld);
+    int nNew = read_csv(fileNew, rowsNew);
+    int i, j, nSlower = 0, nChecksum = 0;
+    double ratio, d;
+    const char *status;
+
+    printf("%-10s %-14s %10s %10s %8s  %s\n", "bench", "phase", "old (s)", "new (s)", "new/old", "status");
+    for (i = 0; i < nNew; i++){
+        for (j = 0; j < nOld; j++){
+            if ((strcmp(rowsOld[j].bench, rowsNew[i].bench) == 0) && (strcmp(rowsOld[j].phase, rowsNew[i].phase) == 0)) break;
+        }
+        if (j == nOld){
+            printf("%-10s %-14s %10s %10.4f %8s  new\n", rowsNew[i].bench, rowsNew[i].phase, "-", rowsNew[i].tmin, "-");
+            continue;
+        }
+        ratio = (rowsOld[j].tmin > 0) ? rowsNew[i].tmin / rowsOld[j].tmin : 1;
+        d = fabs(rowsNew[i].checksum - rowsOld[j].checksum);
+        if (d > MB_CHECKSUM_TOL * fmax(fabs(rowsNew[i].checksum), fabs(rowsOld[j].checksum))){
+            status = "CHECKSUM";
+            nChecksum++;
+        } else if (ratio > 1 + tol){
+            status = "SLOWER";
+            nSlower++;
+        } else if (ratio < 1 / (1 + tol)){
+            status = "faster";
+        } else {
+            status = "ok";
+        }
+        printf("%-10s %-14s %10.4f %10.4f %8.3f  %s\n", rowsNew[i].bench, rowsNew[i].phase, rowsOld[j].tmin, rowsNew[i].tmin, ratio, status);
+        if ((rowsNew[i].threads != rowsOld[j].threads) || (strcmp(rowsNew[i].unit, rowsOld[j].unit) != 0)){
+            printf("%-10s %-14s Warning: different number of threads (%d/%d) or units\n", "", "", rowsOld[j].threads, rowsNew[i].threads);
+        }
+    }
+    printf("\n%d phase(s) slower by more than %.0f%%, %d checksum(s) changed.\n", nSlower, 100 * tol, nChecksum);
+    return (nSlower + nChecksum > 0);
+}
+
+
+/* ===== MAIN ===== */
+static void print_help(void){
+    printf(
+        "USAGE:  mexbench <benchmark> [--option value ...]\n"
+        "        mexbench compare <old.csv> <new.csv> [--tolerance 0.10]\n"
+        "\n"
+        "BENCHMARKS AND OPTIONS (default values):\n"
+        "  meanvar    --rows 200 --cols 100000\n"
+        "  pac        --signals 16 --time 10000 --nlow 20 --nhigh 30\n"
+        "  plx        --channels 32 --rate 2000 --seconds 600 --windows 200 --chunk 10\n"
+        "             --file <existing PLX file> --tmpdir /tmp --keep 0\n"
+        "  permtest   --tests 20000 --samples 20 --perm 1000\n"
+        "  fftfilt    --channels 64 --time 300000 --taps 1001 --chunk 10000\n"
+        "  morlet     --signals 32 --time 5000 --freqs 40 --trials 10 --fs 1000\n"
+        "  xspectrum  --signals 128 --freqs 200 --windows 50\n"
+        "  all        all the benchmarks (an option applies to all the benchmarks that have it)\n"
+        "\n"
+        "COMMON OPTIONS:\n"
+        "  --repeat 3 --threads <all cores> --csv <file> --seed 1\n"
+        "\n"
+        "COLUMNS:\n"
+        "  min/med: minimum/median time (s), GB/s: input data processed per second,\n"
+        "  rate: units processed per second, peak MB: memory allocated by the MEX file,\n"
+        "  checksum: sum of the outputs (must not change between two builds)\n");
+}
+
+int main(int argc, char **argv){
+    static const char *benchNames[7] = {"meanvar", "pac", "plx", "permtest", "fftfilt", "morlet", "xspectrum"};
+    static void (*benchFcns[7])(void) = {bench_meanvar, bench_pac, bench_plx, bench_permtest, bench_fftfilt, bench_morlet, bench_xspectrum};
+    const char *bench, *csvFile;
+    struct rusage usage;
+    struct stat st;
+    int isAll, isFound = 0, i, nThreads, status = 0;
+
+    gArgc = argc;
+    gArgv = argv;
+    gArgUsed = (int*) calloc(argc + 1, sizeof(int));
+    if ((argc < 2) || (strcmp(argv[1], "help") == 0) || (strcmp(argv[1], "--help") == 0)){
+        print_help();
+        return (argc < 2) ? 2 : 0;
+    }
+    bench = argv[1];
+
+    /* Comparison of two CSV files */
+    if (strcmp(bench, "compare") == 0){
+        if ((argc < 4) || (strncmp(argv[2], "--", 2) == 0) || (strncmp(argv[3], "--", 2) == 0)){
+            print_help();
+            return 2;
+        }
+        return compare_runs(argv[2], argv[3], opt_num("tolerance", 0.10));
+    }
+
+    /* Common options */
+    nRepeat  = (int) opt_size("repeat", 3);
+    nThreads = (int) opt_num("threads", 0);
+    rngSeed  = (unsigned long long) opt_size("seed", 1);
+    csvFile  = opt_str("csv", NULL);
+    if (nRepeat > MB_MAXREPEAT){
+        nRepeat = MB_MAXREPEAT;
+    }
+#ifdef _OPENMP
+    if (nThreads > 0){
+        omp_set_num_threads(nThreads);
+    }
+#endif
+    if (csvFile != NULL){
+        int isNew = (stat(csvFile, &st) != 0) || (st.st_size == 0);
+        fidCsv = fopen(csvFile, "a");
+        if (fidCsv == NULL){
+            fprintf(stderr, "Error: Cannot write file %s\n", csvFile);
+            return 2;
+        }
+        if (isNew){
+            fprintf(fidCsv, "bench,phase,threads,repeat,tmin_s,tmed_s,gbps,rate,unit,peak_mb,checksum\n");
+        }
+        fprintf(fidCsv, "# compiler: %s, flags: %s, threads: %d, date: %ld\n", MEXBENCH_COMPILER, MEXBENCH_CFLAGS, get_threads(), (long) time(NULL));
+    }
+
+    printf("Compiler: %s\nFlags:    %s\nThreads:  %d\n\n", MEXBENCH_COMPILER, MEXBENCH_CFLAGS, get_threads());
+    printf("%-10s %-14s %10s %10s %8s %12s %-10s %10s  %s\n", "bench", "phase", "min (s)", "med (s)", "GB/s", "rate", "unit", "peak MB", "checksum");
+    isAll = (strcmp(bench, "all") == 0);
+    for (i = 0; i < 7; i++){
+        if (isAll || (strcmp(bench, benchNames[i]) == 0)){
+            rnd_init(benchNames[i]);
+            benchFcns[i]();
+            isFound = 1;
+        }
+    }
+    if (!isFound){
+        fprintf(stderr, "Error: Unknown benchmark \"%s\".\n", bench);
+        print_help();
+        status = 2;
+    }
+
+    /* Options that were not used by the benchmark */
+    for (i = 2; i < argc; i++){
+        if (!gArgUsed[i]){
+            fprintf(stderr, "Warning: Option %s ignored.\n", argv[i]);
+            if ((strncmp(argv[i], "--", 2) == 0) && (i + 1 < argc) && !gArgUsed[i+1]){
+                i++;
+            }
+        }
+    }
+    if (isFound){
+        getrusage(RUSAGE_SELF, &usage);
+        printf("\nMaximum resident memory: %.1f MB\n", usage.ru_maxrss / 1024.0);
+    }
+    if (fidCsv != NULL){
+        fclose(fidCsv);
+    }
+    free(gArgUsed);
+    if ((status == 0) && (nFailed > 0)){
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,460 @@
+/*--------------------------------------------------------------
+ * file: mexshim.c - Implementation of the minimal MEX API declared in mex.h
+ *
+ * The arrays are allocated with mxMalloc, so the memory of the outputs of the MEX files
+ * is included in the peak memory. The allocation counters are updated atomically, as some
+ * MEX files allocate memory from several threads (outside of OpenMP regions in theory only).
+ *-------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include "mex.h"
+
+/* Maximum number of dimensions of the arrays */
+#define MS_MAXDIM 8
+/* Maximum number of functions registered with mexAtExit */
+#define MS_MAXATEXIT 32
+
+struct mxArray_tag {
+    mxClassID classid;
+    mwSize ndim;
+    mwSize dims[MS_MAXDIM];
+    int isComplex;
+    void *data;             /* Numeric values (interleaved if complex), or characters (null-terminated) */
+    int nfields;            /* Structures: number of fields */
+    char **fieldnames;      /* Structures: names of the fields */
+    mxArray **fields;       /* Structures: values [nElements x nfields] */
+};
+
+/* Header in front of each memory block, to know its size when it is released */
+typedef struct {
+    size_t n;
+    size_t pad;             /* Keeps the data aligned on 16 bytes */
+} ms_header;
+
+static size_t curBytes  = 0;
+static size_t peakBytes = 0;
+static void (*atExitFcn[MS_MAXATEXIT])(void);
+static int nAtExit = 0;
+static int isQuietMode = 0;
+
+
+/* ===== MEMORY ===== */
+static void count_bytes(size_t n, int sign){
+    size_t cur;
+#if defined(__GNUC__)
+    cur = (sign > 0) ? __atomic_add_fetch(&curBytes, n, __ATOMIC_RELAXED) : __atomic_sub_fetch(&curBytes, n, __ATOMIC_RELAXED);
+#else
+    #pragma omp critical(mexshim_mem)
+    {
+        curBytes = (sign > 0) ? curBytes + n : curBytes - n;
+        cur = curBytes;
+    }
+#endif
+    if ((sign > 0) && (cur > peakBytes)){
+        peakBytes = cur;
+    }
+}
+void *mxMalloc(size_t n){
+    ms_header *h = (ms_header*) malloc(sizeof(ms_header) + (n ? n : 1));
+    if (h == NULL){
+        mexErrMsgTxt("Out of memory.");
+    }
+    h->n = n;
+    count_bytes(n, 1);
+    return h + 1;
+}
+void *mxCalloc(size_t n, size_t size){
+    void *p = mxMalloc(n * size);
+    memset(p, 0, n * size);
+    return p;
+}
+void mxFree(void *ptr){
+    ms_header *h;
+    if (ptr == NULL) return;
+    h = (ms_header*) ptr - 1;
+    count_bytes(h->n, -1);
+    free(h);
+}
+void *mxRealloc(void *ptr, size_t n){
+    ms_header *h;
+    void *p;
+    if (ptr == NULL) return mxMalloc(n);
+    h = (ms_header*) ptr - 1;
+    p = mxMalloc(n);
+    memcpy(p, ptr, (h->n < n) ? h->n : n);
+    mxFree(ptr);
+    return p;
+}
+void mexMakeMemoryPersistent(void *ptr){ (void) ptr; }
+void mexMakeArrayPersistent(mxArray *pa){ (void) pa; }
+size_t mexshim_current_bytes(void){ return curBytes; }
+size_t mexshim_peak_bytes(void){ return peakBytes; }
+void mexshim_reset_peak(void){ peakBytes = curBytes; }
+
+
+/* ===== ARRAY CREATION ===== */
+static size_t class_size(mxClassID classid){
+    switch (classid){
+        case mxDOUBLE_CLASS: case mxINT64_CLASS: case mxUINT64_CLASS: return 8;
+        case mxSINGLE_CLASS: case mxINT32_CLASS: case mxUINT32_CLASS: return 4;
+        case mxINT16_CLASS:  case mxUINT16_CLASS: return 2;
+        default: return 1;
+    }
+}
+static mxArray *new_array(mxClassID classid, mwSize ndim, const mwSize *dims){
+    mxArray *pa = (mxArray*) calloc(1, sizeof(mxArray));
+    mwSize i;
+    if (ndim > MS_MAXDIM){
+        mexErrMsgTxt("Too many dimensions.");
+    }
+    pa->classid = classid;
+    pa->ndim    = 2;
+    pa->dims[0] = 0;
+    pa->dims[1] = 0;
+    for (i = 0; i < ndim; i++){
+        pa->dims[i] = dims[i];
+    }
+    if (ndim == 1){
+        pa->dims[1] = 1;
+    }
+    /* Trailing singleton dimensions are removed, as in Matlab */
+    pa->ndim = (ndim > 2) ? ndim : 2;
+    while ((pa->ndim > 2) && (pa->dims[pa->ndim-1] == 1)){
+        pa->ndim--;
+    }
+    return pa;
+}
+mxArray *mxCreateNumericArray(mwSize ndim, const mwSize *dims, mxClassID classid, mxComplexity flag){
+    mxArray *pa = new_array(classid, ndim, dims);
+    pa->isComplex = (flag == mxCOMPLEX);
+    pa->data = mxCalloc(mxGetNumberOfElements(pa) * (pa->isComplex ? 2 : 1), class_size(classid));
+    return pa;
+}
+mxArray *mxCreateNumericMatrix(mwSize m, mwSize n, mxClassID classid, mxComplexity flag){
+    mwSize dims[2];
+    dims[0] = m;
+    dims[1] = n;
+    return mxCreateNumericArray(2, dims, classid, flag);
+}
+mxArray *mxCreateDoubleMatrix(mwSize m, mwSize n, mxComplexity flag){
+    return mxCreateNumericMatrix(m, n, mxDOUBLE_CLASS, flag);
+}
+mxArray *mxCreateDoubleScalar(double value){
+    mxArray *pa = mxCreateDoubleMatrix(1, 1, mxREAL);
+    *(double*) pa->data = value;
+    return pa;
+}
+mxArray *mxCreateLogicalScalar(bool value){
+    mxArray *pa = mxCreateNumericMatrix(1, 1, mxLOGICAL_CLASS, mxREAL);
+    *(mxLogical*) pa->data = value;
+    return pa;
+}
+mxArray *mxCreateString(const char *str){
+    size_t n = strlen(str);
+    mwSize dims[2];
+    mxArray *pa;
+    dims[0] = (n > 0) ? 1 : 0;
+    dims[1] = n;
+    pa = new_array(mxCHAR_CLASS, 2, dims);
+    pa->data = mxCalloc(n + 1, 1);
+    memcpy(pa->data, str, n);
+    return pa;
+}
+mxArray *mxCreateStructMatrix(mwSize m, mwSize n, int nfields, const char **fieldnames){
+    mwSize dims[2];
+    mxArray *pa;
+    int i;
+    dims[0] = m;
+    dims[1] = n;
+    pa = new_array(mxSTRUCT_CLASS, 2, dims);
+    for (i = 0; i < nfields; i++){
+        mxAddField(pa, fieldnames[i]);
+    }
+    return pa;
+}
+mxArray *mxDuplicateArray(const mxArray *pa){
+    mxArray *dup = (mxArray*) calloc(1, sizeof(mxArray));
+    size_t nElem = mxGetNumberOfElements(pa), n, i;
+    int k;
+    *dup = *pa;
+    if (pa->classid == mxSTRUCT_CLASS){
+        dup->data = NULL;
+        dup->fieldnames = (char**) malloc((pa->nfields + 1) * sizeof(char*));
+        dup->fields = (mxArray**) calloc(nElem * pa->nfields + 1, sizeof(mxArray*));
+        for (k = 0; k < pa->nfields; k++){
+            dup->fieldnames[k] = (char*) malloc(strlen(pa->fieldnames[k]) + 1);
+            strcpy(dup->fieldnames[k], pa->fieldnames[k]);
+        }
+        for (i = 0; i < nElem * pa->nfields; i++){
+            dup->fields[i] = (pa->fields[i] != NULL) ? mxDuplicateArray(pa->fields[i]) : NULL;
+        }
+    } else {
+        n = (pa->classid == mxCHAR_CLASS) ? nElem + 1 : nElem * (pa->isComplex ? 2 : 1) * class_size(pa->classid);
+        dup->data = mxMalloc(n);
+        memcpy(dup->data, pa->data, n);
+    }
+    return dup;
+}
+void mxDestroyArray(mxArray *pa){
+    size_t i;
+    int k;
+    if (pa == NULL) return;
+    if (pa->classid == mxSTRUCT_CLASS){
+        for (i = 0; i < mxGetNumberOfElements(pa) * pa->nfields; i++){
+            mxDestroyArray(pa->fields[i]);
+        }
+        for (k = 0; k < pa->nfields; k++){
+            free(pa->fieldnames[k]);
+        }
+        free(pa->fieldnames);
+        free(pa->fields);
+    }
+    mxFree(pa->data);
+    free(pa);
+}
+
+
+/* ===== ARRAY PROPERTIES ===== */
+mxClassID mxGetClassID(const mxArray *pa){ return pa->classid; }
+bool mxIsClass(const mxArray *pa, const char *name){
+    static const char *names[] = {"unknown", "cell", "struct", "logical", "char", "void", "double", "single",
+                                  "int8", "uint8", "int16", "uint16", "int32", "uint32", "int64", "uint64", "function_handle"};
+    return (strcmp(names[pa->classid], name) == 0);
+}
+bool mxIsDouble(const mxArray *pa){ return (pa->classid == mxDOUBLE_CLASS); }
+bool mxIsSingle(const mxArray *pa){ return (pa->classid == mxSINGLE_CLASS); }
+bool mxIsNumeric(const mxArray *pa){ return (pa->classid >= mxDOUBLE_CLASS) && (pa->classid <= mxUINT64_CLASS); }
+bool mxIsComplex(const mxArray *pa){ return pa->isComplex; }
+bool mxIsChar(const mxArray *pa){ return (pa->classid == mxCHAR_CLASS); }
+bool mxIsStruct(const mxArray *pa){ return (pa->classid == mxSTRUCT_CLASS); }
+bool mxIsLogical(const mxArray *pa){ return (pa->classid == mxLOGICAL_CLASS); }
+bool mxIsLogicalScalar(const mxArray *pa){ return mxIsLogical(pa) && (mxGetNumberOfElements(pa) == 1); }
+bool mxIsLogicalScalarTrue(const mxArray *pa){ return mxIsLogicalScalar(pa) && *(mxLogical*) pa->data; }
+bool mxIsEmpty(const mxArray *pa){ return (mxGetNumberOfElements(pa) == 0); }
+size_t mxGetM(const mxArray *pa){ return pa->dims[0]; }
+size_t mxGetN(const mxArray *pa){
+    size_t n = 1;
+    mwSize i;
+    for (i = 1; i < pa->ndim; i++){
+        n *= pa->dims[i];
+    }
+    return n;
+}
+void mxSetM(mxArray *pa, mwSize m){ pa->dims[0] = m; }
+void mxSetN(mxArray *pa, mwSize n){ pa->ndim = 2; pa->dims[1] = n; }
+size_t mxGetNumberOfElements(const mxArray *pa){
+    return pa->dims[0] * mxGetN(pa);
+}
+mwSize mxGetNumberOfDimensions(const mxArray *pa){ return pa->ndim; }
+const mwSize *mxGetDimensions(const mxArray *pa){ return pa->dims; }
+int mxSetDimensions(mxArray *pa, const mwSize *dims, mwSize ndim){
+    mwSize i;
+    if (ndim > MS_MAXDIM) return 1;
+    pa->ndim = (ndim > 2) ? ndim : 2;
+    pa->dims[1] = 1;
+    for (i = 0; i < ndim; i++){
+        pa->dims[i] = dims[i];
+    }
+    return 0;
+}
+
+
+/* ===== DATA ACCESS ===== */
+double *mxGetPr(const mxArray *pa){ return (double*) pa->data; }
+double *mxGetPi(const mxArray *pa){
+#if MX_HAS_INTERLEAVED_COMPLEX
+    (void) pa;
+    return NULL;
+#else
+    return pa->isComplex ? (double*) pa->data + mxGetNumberOfElements(pa) : NULL;
+#endif
+}
+void *mxGetData(const mxArray *pa){ return pa->data; }
+void mxSetData(mxArray *pa, void *data){ pa->data = data; }
+mxComplexDouble *mxGetComplexDoubles(const mxArray *pa){ return (pa->isComplex && mxIsDouble(pa)) ? (mxComplexDouble*) pa->data : NULL; }
+mxComplexSingle *mxGetComplexSingles(const mxArray *pa){ return (pa->isComplex && mxIsSingle(pa)) ? (mxComplexSingle*) pa->data : NULL; }
+double mxGetScalar(const mxArray *pa){
+    if ((pa->data == NULL) || mxIsEmpty(pa)) return 0;
+    switch (pa->classid){
+        case mxDOUBLE_CLASS:  return *(double*)   pa->data;
+        case mxSINGLE_CLASS:  return *(float*)    pa->data;
+        case mxINT8_CLASS:    return *(int8_t*)   pa->data;
+        case mxUINT8_CLASS:   return *(uint8_t*)  pa->data;
+        case mxINT16_CLASS:   return *(int16_t*)  pa->data;
+        case mxUINT16_CLASS:  return *(uint16_t*) pa->data;
+        case mxINT32_CLASS:   return *(int32_t*)  pa->data;
+        case mxUINT32_CLASS:  return *(uint32_t*) pa->data;
+        case mxINT64_CLASS:   return (double) *(int64_t*)  pa->data;
+        case mxUINT64_CLASS:  return (double) *(uint64_t*) pa->data;
+        case mxLOGICAL_CLASS: return *(mxLogical*) pa->data;
+        case mxCHAR_CLASS:    return *(char*)     pa->data;
+        default:              return 0;
+    }
+}
+char *mxArrayToString(const mxArray *pa){
+    char *str;
+    if (!mxIsChar(pa)) return NULL;
+    str = (char*) mxMalloc(strlen((char*) pa->data) + 1);
+    strcpy(str, (char*) pa->data);
+    return str;
+}
+int mxGetString(const mxArray *pa, char *buf, mwSize buflen){
+    if (!mxIsChar(pa) || (buflen == 0)) return 1;
+    strncpy(buf, (char*) pa->data, buflen);
+    buf[buflen - 1] = 0;
+    return (strlen((char*) pa->data) >= buflen);
+}
+
+
+/* ===== STRUCTURES ===== */
+int mxGetFieldNumber(const mxArray *pa, const char *fieldname){
+    int k;
+    if (!mxIsStruct(pa)) return -1;
+    for (k = 0; k < pa->nfields; k++){
+        if (strcmp(pa->fieldnames[k], fieldname) == 0) return k;
+    }
+    return -1;
+}
+int mxAddField(mxArray *pa, const char *fieldname){
+    size_t nElem = mxGetNumberOfElements(pa), i;
+    int k = mxGetFieldNumber(pa, fieldname), nf;
+    mxArray **fields;
+    if (k >= 0) return k;
+    nf = pa->nfields + 1;
+    fields = (mxArray**) calloc(nElem * nf + 1, sizeof(mxArray*));
+    for (i = 0; i < nElem; i++){
+        for (k = 0; k < pa->nfields; k++){
+            fields[i * nf + k] = pa->fields[i * pa->nfields + k];
+        }
+    }
+    free(pa->fields);
+    pa->fields = fields;
+    pa->fieldnames = (char**) realloc(pa->fieldnames, nf * sizeof(char*));
+    pa->fieldnames[nf - 1] = (char*) malloc(strlen(fieldname) + 1);
+    strcpy(pa->fieldnames[nf - 1], fieldname);
+    pa->nfields = nf;
+    return nf - 1;
+}
+void mxRemoveField(mxArray *pa, int fieldnumber){
+    size_t nElem = mxGetNumberOfElements(pa), i;
+    int k, j, nf;
+    mxArray **fields;
+    if ((fieldnumber < 0) || (fieldnumber >= pa->nfields)) return;
+    nf = pa->nfields - 1;
+    fields = (mxArray**) calloc(nElem * nf + 1, sizeof(mxArray*));
+    for (i = 0; i < nElem; i++){
+        for (k = 0, j = 0; k < pa->nfields; k++){
+            if (k != fieldnumber){
+                fields[i * nf + j++] = pa->fields[i * pa->nfields + k];
+            }
+        }
+    }
+    free(pa->fields);
+    pa->fields = fields;
+    free(pa->fieldnames[fieldnumber]);
+    memmove(pa->fieldnames + fieldnumber, pa->fieldnames + fieldnumber + 1, (pa->nfields - fieldnumber - 1) * sizeof(char*));
+    pa->nfields = nf;
+}
+mxArray *mxGetField(const mxArray *pa, mwIndex i, const char *fieldname){
+    int k = mxGetFieldNumber(pa, fieldname);
+    if ((k < 0) || (i >= mxGetNumberOfElements(pa))) return NULL;
+    return pa->fields[i * pa->nfields + k];
+}
+mxArray *mxGetFieldByNumber(const mxArray *pa, mwIndex i, int fieldnumber){
+    if ((fieldnumber < 0) || (fieldnumber >= pa->nfields) || (i >= mxGetNumberOfElements(pa))) return NULL;
+    return pa->fields[i * pa->nfields + fieldnumber];
+}
+const char *mxGetFieldNameByNumber(const mxArray *pa, int fieldnumber){
+    if ((fieldnumber < 0) || (fieldnumber >= pa->nfields)) return NULL;
+    return pa->fieldnames[fieldnumber];
+}
+int mxGetNumberOfFields(const mxArray *pa){ return pa->nfields; }
+void mxSetField(mxArray *pa, mwIndex i, const char *fieldname, mxArray *value){
+    int k = mxGetFieldNumber(pa, fieldname);
+    if ((k < 0) || (i >= mxGetNumberOfElements(pa))) return;
+    pa->fields[i * pa->nfields + k] = value;
+}
+
+
+/* ===== MEX FUNCTIONS ===== */
+void mexErrMsgTxt(const char *msg){
+    fprintf(stderr, "Error: %s\n", msg);
+    exit(1);
+}
+void mexErrMsgIdAndTxt(const char *id, const char *fmt, ...){
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "Error (%s): ", id);
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    exit(1);
+}
+void mexWarnMsgTxt(const char *msg){
+    if (!isQuietMode) fprintf(stderr, "Warning: %s\n", msg);
+}
+void mexWarnMsgIdAndTxt(const char *id, const char *fmt, ...){
+    va_list args;
+    if (isQuietMode) return;
+    va_start(args, fmt);
+    fprintf(stderr, "Warning (%s): ", id);
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
+int mexPrintf(const char *fmt, ...){
+    va_list args;
+    int n;
+    if (isQuietMode) return 0;
+    va_start(args, fmt);
+    n = vprintf(fmt, args);
+    va_end(args);
+    return n;
+}
+int mexshim_quiet(int isQuiet){
+    int prev = isQuietMode;
+    isQuietMode = isQuiet;
+    return prev;
+}
+int mexAtExit(void (*fcn)(void)){
+    int i;
+    for (i = 0; i < nAtExit; i++){
+        if (atExitFcn[i] == fcn) return 0;
+    }
+    if (nAtExit < MS_MAXATEXIT){
+        atExitFcn[nAtExit++] = fcn;
+    }
+    return 0;
+}
+void mexshim_clear(void){
+    int i;
+    for (i = 0; i < nAtExit; i++){
+        atExitFcn[i]();
+    }
+    nAtExit = 0;
+}
+/* Only datenum([Y M D h m s]), proleptic Gregorian calendar (datenum(0,1,1) = 1) */
+int mexCallMATLAB(int nlhs, mxArray *plhs[], int nrhs, mxArray *prhs[], const char *fcn){
+    static const int cumDays[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    const double *d;
+    double dn;
+    int y, m;
+    if ((strcmp(fcn, "datenum") != 0) || (nlhs < 1) || (nrhs < 1) || (mxGetNumberOfElements(prhs[0]) < 6)){
+        return 1;
+    }
+    d = mxGetPr(prhs[0]);
+    y = (int) d[0];
+    m = (int) d[1];
+    if (m < 1) m = 1;
+    if (m > 12) m = 12;
+    dn = 365.0 * y + ceil(y / 4.0) - ceil(y / 100.0) + ceil(y / 400.0) + cumDays[m-1] + d[2];
+    if ((m > 2) && (((y % 4 == 0) && (y % 100 != 0)) || (y % 400 == 0))){
+        dn += 1;
+    }
+    dn += (d[3] + (d[4] + d[5] / 60.0) / 60.0) / 24.0;
+    plhs[0] = mxCreateDoubleScalar(dn);
+    return 0;
+}
@@ -0,0 +1,121 @@
+function err = test_fftfilt(nChan, nTime, nb)
+% TEST_FFTFILT: Compare the compiled function bst_fftfilt with Matlab filter(), in one call and by chunks.
+% 
+% USAGE:  err = test_fftfilt(nChan, nTime, nb)
+%         err = test_fftfilt()
+%
+% INPUT: 
+%     - nChan : Number of signals                  Default: 64
+%     - nTime : Number of time samples             Default: 100000
+%     - nb    : Length of the low-pass FIR filter  Default: 1001
+%
+% OUTPUT:
+%     - err : One row per class of signals (double, single):
+%             [Max error compared with filter(), relative to the max of the output,
+%              Max difference between the calls by chunks and the call on the entire signal,
+%              Max difference after the use of another filter (FFT plans kept in memory)]
+%             The function stops with an error if the first error is above 1e-10 (double) or 1e-6 (single),
+%             or if the other differences are not exactly zero.
+%
+% NOTES:
+%     - The chunks have random lengths, from 1 to 3*nb samples: most of the chunks do not end on a
+%       block of the overlap-save, and some are shorter than the filter.
+%     - Timing of a long recording: test_fftfilt(256, 3600000, 3301);   % 1 hour at 1000Hz
+
+% @=============================================================================
+% This function is part of the Brainstorm software:
+% https://neuroimage.usc.edu/brainstorm
+% 
+% Copyright (c) University of Southern California & McGill University
+% This software is distributed under the terms of the GNU General Public License
+% as published by the Free Software Foundation. Further details on the GPLv3
+% license can be found at http://www.gnu.org/copyleft/gpl.html.
+% 
+% FOR RESEARCH PURPOSES ONLY. THE SOFTWARE IS PROVIDED "AS IS," AND THE
+% UNIVERSITY OF SOUTHERN CALIFORNIA AND ITS COLLABORATORS DO NOT MAKE ANY
+% WARRANTY, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO WARRANTIES OF
+% MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, NOR DO THEY ASSUME ANY
+% LIABILITY OR RESPONSIBILITY FOR THE USE OF THIS SOFTWARE.
+%
+% For more information type "brainstorm license" at command prompt.
+% =============================================================================@
+%
+
+% Default inputs
+if (nargin < 3) || isempty(nb)
+    nb = 1001;
+end
+if (nargin < 2) || isempty(nTime)
+    nTime = 100000;
+end
+if (nargin < 1) || isempty(nChan)
+    nChan = 64;
+end
+% Compile mex-file
+if (exist('bst_fftfilt', 'file') ~= 3) && ~bst_compile_mex('toolbox/math/bst_fftfilt', 0, 1)
+    error('Cannot compile mex function bst_fftfilt.c...');
+end
+
+% Low-pass filters: windowed sinc (without the Signal Processing Toolbox)
+b  = LowPassFir(nb, 20);
+b2 = LowPassFir(2*floor(nb/4)+1, 10);
+% Matlab reference, on a subset of channels, compensated for the delay of the filter
+x = randn(nChan, nTime);
+iChan = 1:min(nChan, 8);
+D = floor((nb-1)/2);
+yRef = filter(b, 1, [x(iChan,:), zeros(length(iChan), D)], [], 2);
+yRef = yRef(:, D+1:end);
+
+classList = {'double', 'single'};
+tolRef = [1e-10, 1e-6];
+err = zeros(length(classList), 3);
+for iClass = 1:length(classList)
+    xc = cast(x, classList{iClass});
+    % Entire signal
+    tic;
+    y = bst_fftfilt(xc, b);
+    el = toc;
+    if ~isa(y, classList{iClass}) || ~isequal(size(y), size(xc))
+        error(['Invalid class or size of the output for class ' classList{iClass} '.']);
+    end
+    err(iClass,1) = max(max(abs(double(y(iChan,:)) - yRef))) / max(abs(yRef(:)));
+    % Chunks of random lengths
+    yc = {};
+    zf = [];
+    iStart = 1;
+    while (iStart <= nTime)
+        iStop = min(iStart + randi(3*nb) - 1, nTime);
+        [yc{end+1}, zf] = bst_fftfilt(xc(:,iStart:iStop), b, zf, iStop == nTime);
+        iStart = iStop + 1;
+    end
+    nChunks = length(yc);
+    yc = [yc{:}];
+    if ~isequal(size(yc), size(y))
+        error(['Invalid number of samples returned by the chunks for class ' classList{iClass} '.']);
+    end
+    err(iClass,2) = max(abs(double(yc(:)) - double(y(:))));
+    % Same filter after another one
+    bst_fftfilt(xc(:,1:min(nTime,10*nb)), b2);
+    y2 = bst_fftfilt(xc, b);
+    err(iClass,3) = max(abs(double(y2(:)) - double(y(:))));
+    disp(sprintf('%-6s: bst_fftfilt %7.3fs (%1.1f Msamples/s)   Max rel error: %g   Difference: %g (%d chunks), %g (other filter)', ...
+                 classList{iClass}, el, nChan * nTime / el / 1e6, err(iClass,1), err(iClass,2), nChunks, err(iClass,3)));
+    % Check results
+    if (err(iClass,1) > tolRef(iClass))
+        error(['Invalid filtered signals for class ' classList{iClass} '.']);
+    end
+    if any(err(iClass,2:3) ~= 0)
+        error(['The calls by chunks or after another filter do not return the same values, for class ' classList{iClass} '.']);
+    end
+end
+end
+
+
+%% ===== LOW-PASS FILTER =====
+% Windowed sinc, cutoff at fs/(2*r)
+function b = LowPassFir(nb, r)
+    t = pi * ((1:nb) - (nb+1)/2) / r;
+    b = sin(t) ./ t;
+    b(t == 0) = 1;
+    b = b .* (0.54 - 0.46 * cos(2*pi*(0:nb-1)/(nb-1))) / r;
+end
@@ -0,0 +1,108 @@
+function err = test_meanvar(M, N)
+% TEST_MEANVAR: Compare the compiled function bst_meanvar with Matlab mean/var, for all the supported classes.
+% 
+% USAGE:  err = test_meanvar(M, N)
+%         err = test_meanvar()
+%
+% INPUT: 
+%     - M : Number of values to average (rows)         Default: 5000
+%     - N : Number of independent measures (columns)   Default: 2000
+%
+% OUTPUT:
+%     - err : Max errors relative to the max of the Matlab values, one row per class (double, single, int16, int32):
+%             [mean, variance with isZeroBad=0, mean, variance with isZeroBad=1]
+%             The function stops with an error if a mean is above 1e-10, if a variance is above 1e-8,
+%             or if the number of averaged values is wrong.
+%
+% NOTES:
+%     - The values have a large offset (1000 + 10*randn), which reveals the rounding errors of the variance.
+%     - 10% of the values are zeros. In the first column, all the values but one are zeros:
+%       with isZeroBad=1, the mean is this value and the variance is 0.
+%     - Previous versions of bst_meanvar (double values only) are compiled again before the test.
+
+% @=============================================================================
+% This function is part of the Brainstorm software:
+% https://neuroimage.usc.edu/brainstorm
+% 
+% Copyright (c) University of Southern California & McGill University
+% This software is distributed under the terms of the GNU General Public License
+% as published by the Free Software Foundation. Further details on the GPLv3
+% license can be found at http://www.gnu.org/copyleft/gpl.html.
+% 
+% FOR RESEARCH PURPOSES ONLY. THE SOFTWARE IS PROVIDED "AS IS," AND THE
+% UNIVERSITY OF SOUTHERN CALIFORNIA AND ITS COLLABORATORS DO NOT MAKE ANY
+% WARRANTY, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO WARRANTIES OF
+% MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, NOR DO THEY ASSUME ANY
+% LIABILITY OR RESPONSIBILITY FOR THE USE OF THIS SOFTWARE.
+%
+% For more information type "brainstorm license" at command prompt.
+% =============================================================================@
+%
+
+% Default inputs
+if (nargin < 2) || isempty(N)
+    N = 2000;
+end
+if (nargin < 1) || isempty(M)
+    M = 5000;
+end
+% Compile mex-file (outdated binaries are compiled again)
+if ~bst_compile_mex('toolbox/math/bst_meanvar', 0, 1, '', @CheckMeanVarMex)
+    error('Cannot compile mex function bst_meanvar.c...');
+end
+
+% Test matrix: large offset, 10% of zeros, only one non-zero value in the first column
+x0 = 1000 + 10 * randn(M, N);
+x0(rand(M, N) < 0.1) = 0;
+x0(:,1) = [1005; zeros(M-1,1)];
+% References with zeros excluded: bad values replaced with NaN
+xz = x0;
+xz(xz == 0) = NaN;
+nzRef = sum(~isnan(xz), 1);
+mzRef = bst_nanmean(xz, 1);
+dz = bsxfun(@minus, xz, mzRef);
+dz(isnan(dz)) = 0;
+vzRef = sum(dz.^2, 1) ./ max(nzRef - 1, 1);
+clear xz dz;
+
+classList = {'double', 'single', 'int16', 'int32'};
+err = zeros(length(classList), 4);
+for iClass = 1:length(classList)
+    % Values rounded by the class of the test matrix: same reference for all the classes
+    x = cast(x0, classList{iClass});
+    % Matlab reference: zeros included
+    tic;
+    xd = double(x);
+    mRef = mean(xd, 1);
+    vRef = var(xd, 0, 1);
+    clear xd;
+    elRef = toc;
+    % Compiled function
+    tic;
+    [m, v, n] = bst_meanvar(x, 0);
+    el = toc;
+    [mz, vz, nz] = bst_meanvar(x, 1);
+    % Errors relative to the max of the reference
+    err(iClass,:) = [max(abs(m - mRef)) / max(abs(mRef)), ...
+                     max(abs(v - vRef)) / max(vRef), ...
+                     max(abs(mz - mzRef)) / max(abs(mzRef)), ...
+                     max(abs(vz - vzRef)) / max(vzRef)];
+    disp(sprintf('%-7s: bst_meanvar %7.3fs, Matlab %7.3fs   Max rel error: mean=%g, var=%g   isZeroBad=1: mean=%g, var=%g', ...
+                 classList{iClass}, el, elRef, err(iClass,:)));
+    % Check results
+    if any(n ~= M) || any(nz ~= nzRef)
+        error(['Invalid number of averaged values for class ' classList{iClass} '.']);
+    end
+    if any(err(iClass,[1 3]) > 1e-10) || any(err(iClass,[2 4]) > 1e-8)
+        error(['Invalid mean or variance for class ' classList{iClass} '.']);
+    end
+end
+end
+
+
+%% ===== CHECK BST_MEANVAR =====
+% Previous versions of bst_meanvar: double values only, zeros excluded from the variance even with isZeroBad=0
+function isOk = CheckMeanVarMex()
+    [m, v] = bst_meanvar(single([1;0;3;0]), 0);
+    isOk = (m == 1) && (v == 2);
+end
@@ -0,0 +1,115 @@
+function err = test_morlet(nChan, nTime, nTrials, Freqs)
+% TEST_MORLET: Compare the compiled function morlet_transform_mex with the Matlab wavelet transform (morlet_transform).
+% 
+% USAGE:  err = test_morlet(nChan, nTime, nTrials, Freqs)
+%         err = test_morlet()
+%
+% INPUT: 
+%     - nChan   : Number of signals                     Default: 32
+%     - nTime   : Number of time samples (at 1000Hz)    Default: 3000
+%     - nTrials : Number of trials accumulated in Pacc  Default: 4
+%     - Freqs   : Frequencies of the wavelets (Hz)      Default: 2:2:100
+%
+% OUTPUT:
+%     - err : Max errors relative to the max of the reference:
+%             [power of one trial, same call with the wavelet spectra kept in memory, shorter signals,
+%              magnitude, weighted sum of the trials added to an accumulator]
+%             The function stops with an error if one of them is above 1e-10, or if the second call
+%             does not return exactly the same values as the first one.
+%
+% NOTES:
+%     - The shorter signals need other wavelet spectra (plans depend on the number of time samples).
+%     - Timing of a study: test_morlet(306, 5000, 100, 1:100);
+
+% @=============================================================================
+% This function is part of the Brainstorm software:
+% https://neuroimage.usc.edu/brainstorm
+% 
+% Copyright (c) University of Southern California & McGill University
+% This software is distributed under the terms of the GNU General Public License
+% as published by the Free Software Foundation. Further details on the GPLv3
+% license can be found at http://www.gnu.org/copyleft/gpl.html.
+% 
+% FOR RESEARCH PURPOSES ONLY. THE SOFTWARE IS PROVIDED "AS IS," AND THE
+% UNIVERSITY OF SOUTHERN CALIFORNIA AND ITS COLLABORATORS DO NOT MAKE ANY
+% WARRANTY, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO WARRANTIES OF
+% MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, NOR DO THEY ASSUME ANY
+% LIABILITY OR RESPONSIBILITY FOR THE USE OF THIS SOFTWARE.
+%
+% For more information type "brainstorm license" at command prompt.
+% =============================================================================@
+%
+
+% Default inputs
+if (nargin < 4) || isempty(Freqs)
+    Freqs = 2:2:100;
+end
+if (nargin < 3) || isempty(nTrials)
+    nTrials = 4;
+end
+if (nargin < 2) || isempty(nTime)
+    nTime = 3000;
+end
+if (nargin < 1) || isempty(nChan)
+    nChan = 32;
+end
+% Compile mex-file
+if (exist('morlet_transform_mex', 'file') ~= 3) && ~bst_compile_mex('toolbox/timefreq/morlet_transform_mex', 0, 1)
+    error('Cannot compile mex function morlet_transform_mex.c...');
+end
+
+% Test signals: noise and 10Hz oscillation, [nChan x nTime x nTrials]
+sfreq = 1000;
+t = (0:nTime-1) / sfreq;
+x = randn(nChan, nTime, nTrials) + repmat(bst_bsxfun(@times, sin(2*pi*10*t), rand(nChan,1)), [1, 1, nTrials]);
+% Matlab reference: complex coefficients of each trial
+tic;
+TF = cell(1, nTrials);
+for i = 1:nTrials
+    TF{i} = morlet_transform(x(:,:,i), t, Freqs, 1, 3, 'n');
+end
+elRef = toc / nTrials;
+Pref = abs(TF{1}) .^ 2;
+
+err = zeros(1, 5);
+% Power of one trial: wavelet spectra computed at the first call
+clear morlet_transform_mex;
+tic;
+P1 = morlet_transform_mex(x(:,:,1), sfreq, Freqs, 1, 3, 'power');
+el = toc;
+err(1) = max(abs(P1(:) - Pref(:))) / max(Pref(:));
+% Same call: wavelet spectra kept in memory
+tic;
+P2 = morlet_transform_mex(x(:,:,1), sfreq, Freqs, 1, 3, 'power');
+elCache = toc;
+err(2) = max(abs(P2(:) - P1(:))) / max(Pref(:));
+% Shorter signals: other wavelet spectra
+nShort = nTime - ceil(nTime / 3);
+TFshort = morlet_transform(x(:,1:nShort,1), t(1:nShort), Freqs, 1, 3, 'n');
+Pshort = morlet_transform_mex(x(:,1:nShort,1), sfreq, Freqs, 1, 3, 'power');
+err(3) = max(abs(Pshort(:) - abs(TFshort(:)).^2)) / max(abs(TFshort(:)).^2);
+% Magnitude
+M = morlet_transform_mex(x(:,:,1), sfreq, Freqs, 1, 3, 'magnitude');
+err(4) = max(abs(M(:) - abs(TF{1}(:)))) / max(abs(TF{1}(:)));
+% All the trials, weighted and added to an accumulator
+w = 1 / nTrials;
+PaccRef = P1;
+for i = 1:nTrials
+    PaccRef = PaccRef + w * abs(TF{i}) .^ 2;
+end
+tic;
+Pacc = morlet_transform_mex(x, sfreq, Freqs, 1, 3, 'power', P1, w);
+elTrials = toc;
+err(5) = max(abs(Pacc(:) - PaccRef(:))) / max(PaccRef(:));
+
+% Display results
+disp(sprintf('morlet_transform_mex : %7.3fs (first call), %7.3fs (wavelets in memory), %7.3fs per trial (%d trials)', el, elCache, elTrials / nTrials, nTrials));
+disp(sprintf('morlet_transform     : %7.3fs per trial   (x%1.1f)', elRef, elRef * nTrials / elTrials));
+disp(sprintf('Max rel error        : power=%g, wavelets in memory=%g, shorter=%g, magnitude=%g, trials=%g', err));
+% Check results
+if (err(2) ~= 0)
+    error('The wavelet spectra kept in memory do not give the same values as the first call.');
+end
+if any(err > 1e-10)
+    error('Invalid wavelet power.');
+end
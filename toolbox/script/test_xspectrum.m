@@ -0,0 +1,96 @@
+function err = test_xspectrum(nSignals, nTime, WinLen)
+% TEST_XSPECTRUM: Compare the all-to-all cross-spectrum of bst_xspectrum, accumulated over the windows by the
+%                 compiled function xspectrum_mex, with the average of the time-resolved cross-spectrum.
+% 
+% USAGE:  err = test_xspectrum(nSignals, nTime, WinLen)
+%         err = test_xspectrum()
+%
+% INPUT: 
+%     - nSignals : Number of signals                       Default: 200
+%     - nTime    : Number of time samples (at 1000Hz)      Default: 20000
+%     - WinLen   : Length of the Fourier windows (s)       Default: 1
+%
+% OUTPUT:
+%     - err : Max errors relative to the max of the reference cross-spectrum:
+%             [full matrix, compressed matrix (isCompressSym=1), Hermitian symmetry of the full matrix]
+%             The function stops with an error if the first two are above 1e-10, or if the full matrix
+%             is not Hermitian (above 1e-12: only the rounding errors of the imaginary part of the diagonal).
+%
+% NOTES:
+%     - The time-resolved reference is computed in Matlab (no xspectrum_mex), on the first 50 signals.
+%     - Timing of a large matrix: test_xspectrum(2000, 60000, 1);
+
+% @=============================================================================
+% This function is part of the Brainstorm software:
+% https://neuroimage.usc.edu/brainstorm
+% 
+% Copyright (c) University of Southern California & McGill University
+% This software is distributed under the terms of the GNU General Public License
+% as published by the Free Software Foundation. Further details on the GPLv3
+% license can be found at http://www.gnu.org/copyleft/gpl.html.
+% 
+% FOR RESEARCH PURPOSES ONLY. THE SOFTWARE IS PROVIDED "AS IS," AND THE
+% UNIVERSITY OF SOUTHERN CALIFORNIA AND ITS COLLABORATORS DO NOT MAKE ANY
+% WARRANTY, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO WARRANTIES OF
+% MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, NOR DO THEY ASSUME ANY
+% LIABILITY OR RESPONSIBILITY FOR THE USE OF THIS SOFTWARE.
+%
+% For more information type "brainstorm license" at command prompt.
+% =============================================================================@
+%
+
+% Default inputs
+if (nargin < 3) || isempty(WinLen)
+    WinLen = 1;
+end
+if (nargin < 2) || isempty(nTime)
+    nTime = 20000;
+end
+if (nargin < 1) || isempty(nSignals)
+    nSignals = 200;
+end
+% Compile mex-file
+if ~bst_compile_mex('toolbox/connectivity/private/xspectrum_mex', 0, 1, '-R2018a')
+    error('Cannot compile mex function xspectrum_mex.c...');
+end
+
+% Test signals: shared oscillation with random delays
+sfreq = 1000;
+t = (0:nTime-1) / sfreq;
+A = randn(nSignals, nTime) + sin(2*pi*10*bst_bsxfun(@plus, t, rand(nSignals,1) / 10));
+
+% Reference: time-resolved cross-spectrum of the first signals, averaged over the windows
+iSig = 1:min(nSignals, 50);
+nSig = length(iSig);
+Sref = bst_xspectrum(A(iSig,:), [], sfreq, WinLen, 0.5, 100, [], 'cohere', 1);
+Sref = reshape(mean(Sref.Sab, 3), nSig, nSig, []);
+maxRef = max(abs(Sref(:)));
+
+err = zeros(1, 3);
+% Full matrix
+tic;
+[S, nWin] = bst_xspectrum(A, [], sfreq, WinLen, 0.5, 100, [], 'cohere', 0);
+el = toc;
+nFreq = size(S.Sab, 3);
+err(1) = max(reshape(abs(S.Sab(iSig,iSig,:) - Sref), 1, [])) / maxRef;
+% Compressed matrix: upper triangle column by column, the first signals are the first values
+tic;
+Sc = bst_xspectrum(A, [], sfreq, WinLen, 0.5, 100, [], 'cohere', 0, 1);
+elC = toc;
+nSigC = nSig * (nSig + 1) / 2;
+SrefC = process_compress_sym('Compress', reshape(Sref, nSig^2, nFreq));
+err(2) = max(reshape(abs(reshape(Sc.Sab(1:nSigC,1,:), nSigC, nFreq) - SrefC), 1, [])) / maxRef;
+% Hermitian symmetry of the full matrix
+err(3) = max(reshape(abs(S.Sab - conj(permute(S.Sab, [2,1,3]))), 1, [])) / maxRef;
+
+% Display results
+disp(sprintf('bst_xspectrum : %7.3fs (full), %7.3fs (compressed, %1.2f Gb)   %d windows, %1.2f Gpairs/s', ...
+             el, elC, numel(Sc.Sab) * 16 / 2^30, nWin, nSignals * (nSignals+1) / 2 * nWin * nFreq / el / 1e9));
+disp(sprintf('Max rel error : %g (full), %g (compressed), %g (symmetry)', err));
+% Check results
+if any(err(1:2) > 1e-10)
+    error('Invalid cross-spectrum.');
+end
+if (err(3) > 1e-12)
+    error('The full cross-spectrum is not Hermitian.');
+end
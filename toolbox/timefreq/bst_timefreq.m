@@ -527,8 +527,36 @@ for iData = 1:length(Data)
                 isError = 1;
                 return;
             end
-            % Compute wavelet decompositions
-            TF = morlet_transform(F, OPTIONS.TimeVector, OPTIONS.Freqs, OPTIONS.MorletFc, OPTIONS.MorletFwhmTc, 'n');
+            % Power or magnitude of signals without imaging kernel: compiled version, without storing the complex coefficients
+            isMorletMex = ismember(lower(OPTIONS.Measure), {'power', 'magnitude'}) && isempty(ImagingKernel) && isreal(F) && ...
+                          ((exist('morlet_transform_mex', 'file') == 3) || bst_compile_mex('toolbox/timefreq/morlet_transform_mex', 0, 1));
+            if isMorletMex
+                % Average of recordings files: no post-processing, the measure is added directly to the accumulator
+                if isAverage && strcmpi(DataType, 'data') && ~(~isempty(OPTIONS.NormalizeFunc) && ismember(OPTIONS.NormalizeFunc, {'multiply', 'multiply2020'}))
+                    % Check if data size is coherent with previous loops
+                    if ~isempty(TF_avg) && ~isequal([size(TF_avg,1), size(TF_avg,2), size(TF_avg,3)], [size(F,1), size(F,2), length(OPTIONS.Freqs)])
+                        Messages = 'Input files have different or number of elements: cannot compute average...';
+                        isError = 1;
+                        return;
+                    end
+                    % Set to zero the bad channels
+                    if ~isempty(iGoodChannels)
+                        F(setdiff(1:size(F,1), iGoodChannels), :) = 0;
+                    end
+                    % Add block to accumulator
+                    TF_avg = morlet_transform_mex(F, sfreq, OPTIONS.Freqs, OPTIONS.MorletFc, OPTIONS.MorletFwhmTc, lower(OPTIONS.Measure), TF_avg, nAvg);
+                    nAvgTotal = nAvgTotal + nAvg;
+                    % Add history message
+                    strHistory = [strHistory, ' - Average TF: ', InitFile, 10];
+                    bst_progress('inc', 1);
+                    continue;
+                end
+                TF = morlet_transform_mex(F, sfreq, OPTIONS.Freqs, OPTIONS.MorletFc, OPTIONS.MorletFwhmTc, lower(OPTIONS.Measure));
+                isMeasureApplied = 1;
+            else
+                % Compute wavelet decompositions
+                TF = morlet_transform(F, OPTIONS.TimeVector, OPTIONS.Freqs, OPTIONS.MorletFc, OPTIONS.MorletFwhmTc, 'n');
+            end
 
         % FFT: Matlab function fft
         case 'fft'
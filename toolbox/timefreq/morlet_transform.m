@@ -73,6 +73,14 @@ end
 Ts = t(2) - t(1); % sampling period of signal
 Fs = 1 / Ts;      % sampling frequency of signal
 
+% Power: compiled version, without storing the complex coefficients
+if strcmp(squared, 'y') && (isa(x,'double') || isa(x,'single')) && isreal(x)
+    if (exist('morlet_transform_mex', 'file') == 3) || bst_compile_mex('toolbox/timefreq/morlet_transform_mex', 0, 1)
+        P = morlet_transform_mex(x, Fs, f, fc, FWHM_tc, 'power');
+        return;
+    end
+end
+
 % Complex morlet wavelet parameters
 scales = f ./ fc; % Scales for wavelet
 sigma_tc = FWHM_tc / sqrt(8*log(2));
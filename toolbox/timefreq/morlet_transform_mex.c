@@ -0,0 +1,401 @@
+/*--------------------------------------------------------------
+ * file: morlet_transform_mex.c - Power of the complex Morlet wavelet transform (compiled version of morlet_transform.m)
+ *                                Optionally accumulated over trials, without storing the complex coefficients
+ *
+ * P = morlet_transform_mex(x, Fs, f, fc, FWHM_tc, Measure, Pacc, w)
+ *
+ * INPUTS:
+ *    - x       : [nSignals x nTime x nTrials] double or single matrix
+ *    - Fs      : Sampling frequency of the signals (Hz)
+ *    - f       : [1 x nFreqs] frequencies in which to estimate the wavelet transform (Hz)
+ *    - fc      : Central frequency of the complex Morlet wavelet (Hz)
+ *    - FWHM_tc : FWHM of the complex Morlet wavelet in time (s)
+ *    - Measure : 'power' (|coef|^2, default) or 'magnitude' (|coef|)
+ *    - Pacc    : [nSignals x nTime x nFreqs] accumulator to add the results to (default: zeros)
+ *    - w       : Weight of the trials in the accumulator (default: 1)
+ * OUTPUTS:
+ *    - P : [nSignals x nTime x nFreqs] double, Pacc + w * sum(measure(coefs), trials)
+ *          With one trial and the default arguments: same as morlet_transform(x,t,f,fc,FWHM_tc,'y')
+ *
+ * The convolution with the wavelets is computed by overlap-save: each block of the signal is transformed
+ * once, and multiplied with the spectra of all the wavelets. The block length only depends on the length
+ * of the longest wavelet, so the memory used does not depend on the length of the signals.
+ * The spectra of the wavelets are kept in memory for the next calls with the same sampling frequency,
+ * frequencies, wavelet parameters and number of time samples (eg. all the trials of a study).
+ * The signals are distributed over the available cores by groups, when compiled with OpenMP.
+ *-------------------------------------------------------------- */
+#include <math.h>
+#include <string.h>
+#include "mex.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Compile with:
+ * mex -v morlet_transform_mex.c
+ * or with OpenMP (Linux):
+ * mex -v CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" morlet_transform_mex.c */
+
+/* Number of wavelet plans kept in memory */
+#define MW_NPLANS 4
+/* Number of signals processed together (consecutive in memory in the input matrix) */
+#define MW_GROUP 8
+/* Maximum FFT length */
+#define MW_MAXFFT (1 << 24)
+/* Truncation of the wavelets: +/- MW_PRECISION standard deviations (same as morlet_transform.m) */
+#define MW_PRECISION 3
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(_OPENMP) && defined(_MSC_VER)
+#define MW_OMP_FOR __pragma(omp parallel for schedule(dynamic,1))
+#elif defined(_OPENMP)
+#define MW_OMP_FOR _Pragma("omp parallel for schedule(dynamic,1)")
+#else
+#define MW_OMP_FOR
+#endif
+
+/* Wavelet plan: spectra of all the wavelets for one set of parameters */
+typedef struct {
+    int nfft;       /* FFT length (power of 2) */
+    int nFreq;      /* Number of frequencies */
+    int nTime;      /* Number of time samples (the FFT length depends on it for short signals) */
+    double Fs, fc, FWHM_tc;
+    double *f;      /* Frequencies (key of the cache) */
+    int nPre;       /* Number of past samples needed by the longest wavelet */
+    int L;          /* Number of output samples per block */
+    double *tw;     /* Twiddle factors: exp(-2i*pi*k/nfft), k < nfft/2 */
+    int *rev;       /* Bit-reversal permutation */
+    double *W;      /* Spectra of the centered wavelets, scaled for the inverse FFT [nFreq x nfft complex] */
+} mw_plan;
+
+static mw_plan plans[MW_NPLANS];
+static int nextPlan = 0;
+
+
+/*--------------------------------------------------------------
+ * function: free_plan / free_plans - Release the cached plans
+ *-------------------------------------------------------------- */
+static void free_plan(mw_plan *p){
+    if (p->nfft == 0) return;
+    mxFree(p->f);
+    mxFree(p->tw);
+    mxFree(p->rev);
+    mxFree(p->W);
+    p->nfft = 0;
+}
+static void free_plans(void){
+    int i;
+    for (i=0; i<MW_NPLANS; i++){
+        free_plan(&plans[i]);
+    }
+}
+
+
+/*--------------------------------------------------------------
+ * function: cfft - In-place radix-2 complex FFT (interleaved real/imaginary), unscaled
+ *-------------------------------------------------------------- */
+static void cfft(double *z, int n, const double *tw, const int *rev, int isInverse){
+    int i, j, k, len, half, step;
+    double tr, ti, wr, wi, ur, ui;
+    /* Bit-reversal permutation */
+    for (i=0; i<n; i++){
+        j = rev[i];
+        if (i < j){
+            tr = z[2*i]; z[2*i] = z[2*j]; z[2*j] = tr;
+            ti = z[2*i+1]; z[2*i+1] = z[2*j+1]; z[2*j+1] = ti;
+        }
+    }
+    /* Butterflies */
+    for (len=2; len<=n; len<<=1){
+        half = len >> 1;
+        step = n / len;
+        for (i=0; i<n; i+=len){
+            for (k=0; k<half; k++){
+                wr = tw[2*k*step];
+                wi = isInverse ? -tw[2*k*step+1] : tw[2*k*step+1];
+                j  = i + k;
+                ur = z[2*(j+half)];
+                ui = z[2*(j+half)+1];
+                tr = ur * wr - ui * wi;
+                ti = ur * wi + ui * wr;
+                z[2*(j+half)]   = z[2*j]   - tr;
+                z[2*(j+half)+1] = z[2*j+1] - ti;
+                z[2*j]   += tr;
+                z[2*j+1] += ti;
+            }
+        }
+    }
+}
+
+
+/*--------------------------------------------------------------
+ * function: wavelet_length - Number of samples of the wavelet at frequency f, and index of its center
+ *           (xval = -3*sigma_t : 1/Fs : 3*sigma_t in morlet_transform.m, centered by conv2(...,'same'))
+ *-------------------------------------------------------------- */
+static int wavelet_length(double f, double Fs, double fc, double FWHM_tc, double *sigma_t){
+    double sigma_tc = FWHM_tc / sqrt(8 * log(2.0));
+    *sigma_t = sigma_tc / (f / fc);
+    return (int) floor(2 * MW_PRECISION * (*sigma_t) * Fs + 1e-9) + 1;
+}
+
+
+/*--------------------------------------------------------------
+ * function: get_plan - Returns the wavelet plan, from the cache or computed
+ *-------------------------------------------------------------- */
+static const mw_plan* get_plan(double Fs, const double *f, int nFreq, double fc, double FWHM_tc, int nTime){
+    mw_plan *p;
+    double sigma_t, sigma_tc, scale, norm, x, g, cost, bestCost = 0;
+    int iPlan, s, i, j, bits, nk, h, nPre = 0, nPost = 0, nfft, n, nMax;
+    double *z;
+    /* Search the cache */
+    for (iPlan=0; iPlan<MW_NPLANS; iPlan++){
+        p = &plans[iPlan];
+        if ((p->nfft != 0) && (p->nFreq == nFreq) && (p->nTime == nTime) && (p->Fs == Fs) && (p->fc == fc)
+                && (p->FWHM_tc == FWHM_tc) && (memcmp(p->f, f, nFreq * sizeof(double)) == 0)){
+            return p;
+        }
+    }
+    /* Support of the wavelets, relative to the output sample */
+    for (s=0; s<nFreq; s++){
+        nk = wavelet_length(f[s], Fs, fc, FWHM_tc, &sigma_t);
+        h  = nk / 2;
+        if (nk - 1 - h > nPre)  nPre  = nk - 1 - h;
+        if (h > nPost)          nPost = h;
+    }
+    /* FFT length: minimal cost per output sample, but no longer than needed for the entire signal */
+    nMax = 256;
+    while ((nMax < nTime + nPre + nPost) && (nMax < MW_MAXFFT)) nMax <<= 1;
+    nfft = 0;
+    for (n=256; n<=nMax; n<<=1){
+        if (n - nPre - nPost < 1) continue;
+        cost = n * log((double) n) / (double) (n - nPre - nPost);
+        if ((nfft == 0) || (cost < bestCost)){
+            nfft = n;
+            bestCost = cost;
+        }
+    }
+    if (nfft == 0){
+        return NULL;
+    }
+    /* Replace the oldest plan */
+    p = &plans[nextPlan];
+    nextPlan = (nextPlan + 1) % MW_NPLANS;
+    free_plan(p);
+    p->f   = (double*) mxMalloc(nFreq * sizeof(double));
+    p->tw  = (double*) mxMalloc(nfft * sizeof(double));
+    p->rev = (int*)    mxMalloc(nfft * sizeof(int));
+    p->W   = (double*) mxCalloc((size_t) nFreq * 2 * nfft, sizeof(double));
+    memcpy(p->f, f, nFreq * sizeof(double));
+    p->nFreq   = nFreq;
+    p->nTime   = nTime;
+    p->Fs      = Fs;
+    p->fc      = fc;
+    p->FWHM_tc = FWHM_tc;
+    p->nPre    = nPre;
+    p->L       = nfft - nPre - nPost;
+    for (i=0; i<nfft/2; i++){
+        p->tw[2*i]   = cos(2 * M_PI * i / nfft);
+        p->tw[2*i+1] = -sin(2 * M_PI * i / nfft);
+    }
+    for (bits=0; (1 << bits) < nfft; bits++);
+    for (i=0; i<nfft; i++){
+        for (j=0, p->rev[i]=0; j<bits; j++){
+            p->rev[i] |= ((i >> j) & 1) << (bits - 1 - j);
+        }
+    }
+    p->nfft = nfft;
+    /* Spectra of the wavelets: sqrt(scale) * morlet_wavelet(scale*xval, fc, sigma_tc) * Ts, centered on sample 0 */
+    sigma_tc = FWHM_tc / sqrt(8 * log(2.0));
+    norm = 1 / sqrt(sigma_tc * sqrt(M_PI));
+    for (s=0; s<nFreq; s++){
+        z = p->W + (size_t) s * 2 * nfft;
+        scale = f[s] / fc;
+        nk = wavelet_length(f[s], Fs, fc, FWHM_tc, &sigma_t);
+        h  = nk / 2;
+        for (j=0; j<nk; j++){
+            x = scale * (-MW_PRECISION * sigma_t + j / Fs);
+            g = sqrt(scale) * norm * exp(-x * x / (2 * sigma_tc * sigma_tc)) / Fs;
+            i = ((j - h) % nfft + nfft) % nfft;
+            z[2*i]   = g * cos(2 * M_PI * fc * x);
+            z[2*i+1] = g * sin(2 * M_PI * fc * x);
+        }
+        cfft(z, nfft, p->tw, p->rev, 0);
+        /* Scaling of the inverse FFT */
+        for (i=0; i<2*nfft; i++){
+            z[i] /= (double) nfft;
+        }
+    }
+    mexMakeMemoryPersistent(p->f);
+    mexMakeMemoryPersistent(p->tw);
+    mexMakeMemoryPersistent(p->rev);
+    mexMakeMemoryPersistent(p->W);
+    mexAtExit(free_plans);
+    return p;
+}
+
+
+/*--------------------------------------------------------------
+ * function: mexFunction - Entry point from Matlab environment
+ * INPUTS:
+ * nlhs - number of left hand side arguments (outputs)
+ * plhs[] - pointer to table where created matrix pointers are
+ * to be placed
+ * nrhs - number of right hand side arguments (inputs)
+ * prhs[] - pointer to table of input matrices
+ *-------------------------------------------------------------- */
+void mexFunction( int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[] ){
+    const mw_plan *p;
+    const mwSize *dims;
+    mwSize outDims[3];
+    char *strMeasure;
+    const void *X;
+    double *P, *work, Fs, fc, FWHM_tc, w = 1;
+    int nChan, nTime, nTrials, nFreq, isSingle, isMagnitude = 0, nThreads, nGroups, g, i;
+    size_t nWork;
+
+    /* Input checks */
+    if (nrhs < 5)
+        mexErrMsgTxt("Not enough input arguments.");
+    if (nrhs > 8)
+        mexErrMsgTxt("Too many input arguments.");
+    if (nlhs > 1)
+        mexErrMsgTxt("Too many output arguments.");
+    if ((!mxIsDouble(prhs[0]) && !mxIsSingle(prhs[0])) || mxIsComplex(prhs[0]) || (mxGetNumberOfDimensions(prhs[0]) > 3))
+        mexErrMsgTxt("Argument x must be a real [nSignals x nTime x nTrials] matrix of type double or single.");
+    if (!mxIsDouble(prhs[2]) || mxIsEmpty(prhs[2]))
+        mexErrMsgTxt("Argument f must be a vector of frequencies.");
+    dims     = mxGetDimensions(prhs[0]);
+    nChan    = (int) dims[0];
+    nTime    = (int) dims[1];
+    nTrials  = (mxGetNumberOfDimensions(prhs[0]) > 2) ? (int) dims[2] : 1;
+    isSingle = mxIsSingle(prhs[0]);
+    X        = mxGetData(prhs[0]);
+    Fs       = mxGetScalar(prhs[1]);
+    nFreq    = (int) mxGetNumberOfElements(prhs[2]);
+    fc       = mxIsEmpty(prhs[3]) ? 1 : mxGetScalar(prhs[3]);
+    FWHM_tc  = mxIsEmpty(prhs[4]) ? 3 : mxGetScalar(prhs[4]);
+    for (i=0; i<nFreq; i++){
+        if (!(mxGetPr(prhs[2])[i] > 0))
+            mexErrMsgTxt("All the frequencies must be > 0.");
+    }
+    if (!(Fs > 0) || !(fc > 0) || !(FWHM_tc > 0))
+        mexErrMsgTxt("Fs, fc and FWHM_tc must be > 0.");
+    if ((nrhs >= 6) && !mxIsEmpty(prhs[5])){
+        if (!mxIsChar(prhs[5]))
+            mexErrMsgTxt("Measure must be 'power' or 'magnitude'.");
+        strMeasure = mxArrayToString(prhs[5]);
+        if (strcmp(strMeasure, "magnitude") == 0){
+            isMagnitude = 1;
+        } else if (strcmp(strMeasure, "power") != 0){
+            mexErrMsgTxt("Measure must be 'power' or 'magnitude'.");
+        }
+        mxFree(strMeasure);
+    }
+    if ((nrhs >= 8) && !mxIsEmpty(prhs[7])){
+        w = mxGetScalar(prhs[7]);
+    }
+
+    /* Initialize output: copy of the accumulator, or zeros */
+    outDims[0] = nChan;
+    outDims[1] = nTime;
+    outDims[2] = nFreq;
+    if ((nrhs >= 7) && !mxIsEmpty(prhs[6])){
+        if (!mxIsDouble(prhs[6]) || mxIsComplex(prhs[6]) || (mxGetNumberOfElements(prhs[6]) != (size_t) nChan * nTime * nFreq)
+                || ((int) mxGetM(prhs[6]) != nChan))
+            mexErrMsgTxt("The accumulator must be a real [nSignals x nTime x nFreqs] double matrix.");
+        plhs[0] = mxDuplicateArray(prhs[6]);
+        mxSetDimensions(plhs[0], outDims, 3);
+    } else {
+        plhs[0] = mxCreateNumericArray(3, outDims, mxDOUBLE_CLASS, mxREAL);
+    }
+    P = mxGetPr(plhs[0]);
+    if ((nChan == 0) || (nTime == 0) || (nTrials == 0)){
+        return;
+    }
+
+    /* Spectra of the wavelets */
+    p = get_plan(Fs, mxGetPr(prhs[2]), nFreq, fc, FWHM_tc, nTime);
+    if (p == NULL)
+        mexErrMsgTxt("Wavelets too long for the FFT.");
+
+    /* Work buffers: one per thread, allocated here (mxMalloc is not thread-safe) */
+#ifdef _OPENMP
+    nThreads = omp_get_max_threads();
+#else
+    nThreads = 1;
+#endif
+    nWork = (size_t) 2 * MW_GROUP * 2 * p->nfft;
+    work = (double*) mxMalloc(nThreads * nWork * sizeof(double));
+    nGroups = (nChan + MW_GROUP - 1) / MW_GROUP;
+
+    /* Process the signals by groups */
+    MW_OMP_FOR
+    for (g=0; g<nGroups; g++){
+#ifdef _OPENMP
+        double *buf = work + (size_t) omp_get_thread_num() * nWork;
+#else
+        double *buf = work;
+#endif
+        const int nfft = p->nfft, L = p->L, nPre = p->nPre;
+        double *Xf = buf;                                   /* Spectra of the blocks [MW_GROUP x nfft complex] */
+        double *Y  = buf + (size_t) MW_GROUP * 2 * nfft;    /* Inverse FFT, for one frequency [MW_GROUP x nfft complex] */
+        int c0 = g * MW_GROUP, nc = (nChan - c0 < MW_GROUP) ? (nChan - c0) : MW_GROUP;
+        int c, k, s, t, tr, nt;
+        long j0, j;
+        double a, b, wr, wi, v;
+        for (tr=0; tr<nTrials; tr++){
+            size_t offTrial = (size_t) tr * nChan * nTime;
+            for (j0=0; j0<nTime; j0+=L){
+                nt = (nTime - j0 < L) ? (int) (nTime - j0) : L;
+                /* Gather the samples [j0-nPre, j0-nPre+nfft): consecutive signals are contiguous */
+                for (k=0; k<nfft; k++){
+                    j = j0 - nPre + k;
+                    for (c=0; c<nc; c++){
+                        if ((j < 0) || (j >= nTime)){
+                            v = 0;
+                        } else if (isSingle){
+                            v = ((const float*) X)[offTrial + c0 + c + (size_t) j * nChan];
+                        } else {
+                            v = ((const double*) X)[offTrial + c0 + c + (size_t) j * nChan];
+                        }
+                        Xf[2 * ((size_t) c * nfft + k)]     = v;
+                        Xf[2 * ((size_t) c * nfft + k) + 1] = 0;
+                    }
+                }
+                for (c=0; c<nc; c++){
+                    cfft(Xf + (size_t) c * 2 * nfft, nfft, p->tw, p->rev, 0);
+                }
+                /* Convolution with each wavelet */
+                for (s=0; s<p->nFreq; s++){
+                    const double *W = p->W + (size_t) s * 2 * nfft;
+                    double *Ps = P + (size_t) s * nChan * nTime;
+                    for (c=0; c<nc; c++){
+                        const double *Xc = Xf + (size_t) c * 2 * nfft;
+                        double *Yc = Y + (size_t) c * 2 * nfft;
+                        for (k=0; k<nfft; k++){
+                            a  = Xc[2*k];  b  = Xc[2*k+1];
+                            wr = W[2*k];   wi = W[2*k+1];
+                            Yc[2*k]   = a * wr - b * wi;
+                            Yc[2*k+1] = a * wi + b * wr;
+                        }
+                        cfft(Yc, nfft, p->tw, p->rev, 1);
+                    }
+                    /* Measure, added to the accumulator */
+                    for (t=0; t<nt; t++){
+                        for (c=0; c<nc; c++){
+                            a = Y[2 * ((size_t) c * nfft + nPre + t)];
+                            b = Y[2 * ((size_t) c * nfft + nPre + t) + 1];
+                            v = a * a + b * b;
+                            if (isMagnitude) v = sqrt(v);
+                            Ps[c0 + c + (size_t) (j0 + t) * nChan] += w * v;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    mxFree(work);
+} /* end mexFunction() */
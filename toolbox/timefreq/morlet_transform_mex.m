@@ -0,0 +1,54 @@
+function varargout = morlet_transform_mex(varargin)
+%MORLET_TRANSFORM_MEX: Mex-file computing the power of the complex Morlet wavelet transform, optionally accumulated over trials
+%
+% USAGE:  P = morlet_transform_mex(x, Fs, f, fc=1, FWHM_tc=3, Measure='power')
+%         P = morlet_transform_mex(x, Fs, f, fc=1, FWHM_tc=3, Measure='power', Pacc, w=1)
+% 
+% INPUTS: 
+%    - x       : [nSignals x nTime x nTrials] double or single matrix
+%    - Fs      : Sampling frequency of the signals (Hz)
+%    - f       : Vector of frequencies in which to estimate the wavelet transform (Hz)
+%    - fc      : Central frequency of the complex Morlet wavelet in Hz
+%    - FWHM_tc : FWHM of the complex Morlet wavelet in time
+%    - Measure : 'power' (squared magnitude of the coefficients) or 'magnitude'
+%    - Pacc    : [nSignals x nTime x nFreqs] accumulator the results are added to (default: zeros)
+%    - w       : Weight of each trial in the accumulator (default: 1)
+%
+% OUTPUTS:
+%    - P : [nSignals x nTime x nFreqs] double, Pacc + w * (sum over the trials of the measure of the coefficients)
+%          With one trial and the default arguments: same as morlet_transform(x, t, f, fc, FWHM_tc, 'y')
+%
+% NOTES:
+%    - The convolutions are computed by FFT on blocks of the signals, the complex coefficients are never stored.
+%    - The spectra of the wavelets are kept in memory for the following calls with the same Fs, f, fc, FWHM_tc
+%      and number of time samples (eg. all the trials of a study).
+%
+% EXAMPLE: Average power over trials
+%    P = [];
+%    for i = 1:nTrials
+%        P = morlet_transform_mex(x{i}, Fs, f, fc, FWHM_tc, 'power', P, 1/nTrials);
+%    end
+% 
+% COMPILE:
+%    mex -v morlet_transform_mex.c
+%    Multithreaded (Linux): mex -v CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp" morlet_transform_mex.c
+
+% @=============================================================================
+% This function is part of the Brainstorm software:
+% https://neuroimage.usc.edu/brainstorm
+% 
+% Copyright (c) University of Southern California & McGill University
+% This software is distributed under the terms of the GNU General Public License
+% as published by the Free Software Foundation. Further details on the GPLv3
+% license can be found at http://www.gnu.org/copyleft/gpl.html.
+% 
+% FOR RESEARCH PURPOSES ONLY. THE SOFTWARE IS PROVIDED "AS IS," AND THE
+% UNIVERSITY OF SOUTHERN CALIFORNIA AND ITS COLLABORATORS DO NOT MAKE ANY
+% WARRANTY, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO WARRANTIES OF
+% MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, NOR DO THEY ASSUME ANY
+% LIABILITY OR RESPONSIBILITY FOR THE USE OF THIS SOFTWARE.
+%
+% For more information type "brainstorm license" at command prompt.
+% =============================================================================@
+
+error('Mex-function morlet_transform_mex.c not compiled.');